@@ -358,14 +358,37 @@ Definition macros for source implementation files
 		__VA_ARGS__ \
 	} \
 	EXTERNC Object* CLASS##_create(EXPAND INITARGS) { \
-		Object* self = Object_create(); \
+		Object* self = CLASS_RECYCLABLE INITARGS ? Object_recycled_take(&CLASS##_class) : NULL; \
+		if (self) \
+			return self; \
+		self = Object_create(); \
 		CLASS##_specialize(self COMMA_EXPAND INITARGNAMES); \
+		if (CLASS_RECYCLABLE INITARGS && CLASS##_class.reset) \
+			Object_recycle_register(&CLASS##_class, self); \
 		return self; \
 	}
 
 
+/** Expands `CLASS_RECYCLABLE ()` to true, since a _create() function without arguments can return a recycled object as is.
+Expands `CLASS_RECYCLABLE (int n)` to false.
+*/
+#define CLASS_RECYCLABLE(...) (__VA_OPT__(0 &&) 1)
+
+
 #define DEFINE_CLASS_FREE(CLASS, ...) \
 	static void CLASS##_free(Object* self) { \
+		if (!self) \
+			return; \
+		CLASS* slot = (CLASS*) Object_slots_get(self, &CLASS##_class); \
+		if (!slot) \
+			return; \
+		(void) slot; \
+		__VA_ARGS__ \
+	}
+
+
+#define DEFINE_CLASS_RESET(CLASS, ...) \
+	static void CLASS##_reset(Object* self) { \
 		if (!self) \
 			return; \
 		CLASS* slot = (CLASS*) Object_slots_get(self, &CLASS##_class); \
@@ -376,6 +399,11 @@ Definition macros for source implementation files
 
 
 #define DEFINE_CLASS(CLASS, INITARGS, INITARGNAMES, INIT, ...) \
+	DEFINE_CLASS_FLAGS(CLASS, 0, INITARGS, INITARGNAMES, INIT, __VA_ARGS__)
+
+
+/** Like DEFINE_CLASS(), but sets the class's CLASS_FLAG_* flags. */
+#define DEFINE_CLASS_FLAGS(CLASS, FLAGS, INITARGS, INITARGNAMES, INIT, ...) \
 	extern const Class CLASS##_class; \
 	typedef struct CLASS CLASS; \
 	DEFINE_CLASS_FUNCTIONS(CLASS, INITARGS, INITARGNAMES, INIT) \
@@ -383,6 +411,68 @@ Definition macros for source implementation files
 	const Class CLASS##_class = { \
 		#CLASS, \
 		CLASS##_free, \
+		FLAGS, \
+		NULL, \
+		0, \
+		0, \
+		{} \
+	};
+
+
+/** Like DEFINE_CLASS_FLAGS(), but objects of the class can be recycled with Object_recycle_capacity_set().
+RESET is run with `slot` when an object is recycled instead of freed, and must return the slot to the state that INIT leaves it in.
+It may release references held by the slot.
+
+Example:
+	DEFINE_CLASS_RECYCLED(Voice, 0, (), (), {
+		Voice* slot = (Voice*) calloc(1, sizeof(Voice));
+		PUSH_CLASS(self, Voice, slot);
+	}, {
+		memset(slot, 0, sizeof(Voice));
+	}, {
+		free(slot);
+	})
+*/
+#define DEFINE_CLASS_RECYCLED(CLASS, FLAGS, INITARGS, INITARGNAMES, INIT, RESET, ...) \
+	extern const Class CLASS##_class; \
+	typedef struct CLASS CLASS; \
+	DEFINE_CLASS_FUNCTIONS(CLASS, INITARGS, INITARGNAMES, INIT) \
+	DEFINE_CLASS_FREE(CLASS, __VA_ARGS__) \
+	DEFINE_CLASS_RESET(CLASS, RESET) \
+	const Class CLASS##_class = { \
+		#CLASS, \
+		CLASS##_free, \
+		FLAGS, \
+		CLASS##_reset, \
+		0, \
+		0, \
+		{} \
+	};
+
+
+/** Like DEFINE_CLASS_FLAGS(), but the runtime allocates the class's zeroed slot with PUSH_CLASS_ALLOC() and frees it after the free body runs.
+The free body releases only what the slot points to, and may be empty.
+
+Example:
+	DEFINE_CLASS_ALLOC(Cat, 0, (), (), {
+		Cat* slot = PUSH_CLASS_ALLOC(self, Cat);
+		slot->lives = 9;
+	}, {
+		free(slot->name);
+	})
+*/
+#define DEFINE_CLASS_ALLOC(CLASS, FLAGS, INITARGS, INITARGNAMES, INIT, ...) \
+	extern const Class CLASS##_class; \
+	typedef struct CLASS CLASS; \
+	DEFINE_CLASS_FUNCTIONS(CLASS, INITARGS, INITARGNAMES, INIT) \
+	DEFINE_CLASS_FREE(CLASS, __VA_ARGS__) \
+	const Class CLASS##_class = { \
+		#CLASS, \
+		CLASS##_free, \
+		FLAGS, \
+		NULL, \
+		sizeof(CLASS), \
+		__alignof__(CLASS), \
 		{} \
 	};
 
@@ -627,6 +717,10 @@ Call macros
 	Object_classes_push(SELF, &CLASS##_class, SLOT)
 
 
+#define PUSH_CLASS_ALLOC(SELF, CLASS) \
+	((CLASS*) Object_classes_push_alloc(SELF, &CLASS##_class))
+
+
 #define SLOT(SELF, CLASS) \
 	((CLASS*) Object_slots_get(SELF, &CLASS##_class))
 
@@ -700,6 +794,7 @@ EXTERNC_BEGIN
 typedef struct Object Object;
 
 typedef void Object_free_m(Object* self);
+typedef void Object_reset_m(Object* self);
 
 typedef struct Class {
 	const char* name;
@@ -707,13 +802,30 @@ typedef struct Class {
 	May be NULL if the class has no slot to free.
 	*/
 	Object_free_m* free;
+	/** Bitwise OR of CLASS_FLAG_* values. */
+	uintptr_t flags;
+	/** Returns the class's slot to its freshly specialized state, so the object can be reused instead of freed.
+	Objects are only recycled if all their classes have a reset() function.
+	May be NULL.
+	*/
+	Object_reset_m* reset;
+	/** Size in bytes of the class's slot if the runtime allocates it with PUSH_CLASS_ALLOC(), or 0 if the class allocates its own slot.
+	The runtime frees such slots after free() returns, so free() must only release the slot's contents.
+	*/
+	uintptr_t slotSize;
+	/** Alignment of a runtime-allocated slot, a power of 2, or 0 for the alignment of max_align_t. */
+	uintptr_t slotAlign;
 	/** Reserved for future fields.
 	Must be zero.
 	*/
-	void* reserved[30];
+	void* reserved[26];
 } Class;
 
 
+/** The class's free() function isn't thread-safe, so Object_unref_parallel() frees objects of this class on its calling thread. */
+#define CLASS_FLAG_FREE_SERIAL ((uintptr_t) 1 << 0)
+
+
 /** Creates an object with no classes.
 Reference count is set to 1.
 Object must be unreferenced with Object_unref() to prevent a memory leak.
@@ -723,6 +835,111 @@ __attribute__((warn_unused_result))
 Object* Object_create(void);
 
 
+/** Returns the size of an object shell, for embedding shells in storage owned by the caller with Object_init_in().
+The shell stays opaque, and its size may change between runtime versions, so query it rather than hard-coding it.
+*/
+size_t Object_size_get(void);
+/** Returns the alignment that storage passed to Object_init_in() must have. */
+size_t Object_align_get(void);
+
+
+/** Creates an object with no classes in caller-provided storage of at least Object_size_get() bytes aligned to Object_align_get(), such as a field of a struct, an array element, or a stack buffer.
+The returned reference belongs to the storage, so release it with Object_deinit() rather than Object_unref().
+The runtime never deletes the storage, which may be reused after Object_deinit().
+Returns NULL if buffer is NULL or misaligned.
+*/
+__attribute__((warn_unused_result))
+Object* Object_init_in(void* buffer);
+
+
+/** Releases the storage's reference of an object created by Object_init_in(), and frees it, so its storage can be reused or go out of scope.
+Other references must be released beforehand, since they would dangle.
+Unless the runtime is built with NDEBUG, remaining references are reported on stderr and abort the program.
+The object is freed on the calling thread, even if it defers unrefs with Object_thread_unref_deferred_set().
+Does nothing if self is NULL or wasn't created by Object_init_in().
+*/
+void Object_deinit(Object* self);
+
+
+/** A bump allocator for short-lived objects, such as per-frame temporaries, which are freed together by Object_region_destroy() instead of each being unreferenced.
+Not thread-safe: create objects in a region, push their classes, and allocate from it on one thread at a time.
+Its objects can still be referenced and unreferenced from any thread.
+*/
+typedef struct ObjectRegion ObjectRegion;
+
+
+/** Sets the maximum number of released objects kept for reuse per class registered with Object_recycle_register(), which is 0 by default.
+An object is kept instead of freed when its last strong ref is released if each of its classes has a reset() function, if it has no weak refs or side records, if it wasn't created in a region or caller storage, and if it has the same classes and methods as a new object returned by a class's _create() function.
+Its slots are reset from top to bottom and kept, and a later call of that _create() function returns it without specializing or allocating.
+Only _create() functions without arguments reuse objects.
+Keeping and taking objects neither locks nor allocates.
+Lowering the capacity frees the objects beyond it.
+*/
+void Object_recycle_capacity_set(uint32_t capacity);
+uint32_t Object_recycle_capacity_get(void);
+
+
+/** Returns an object kept for reuse with the same classes and methods as a new object from cls's _create() function, with a reference count of 1.
+Returns NULL if none is kept, or if the calling thread has a region set with Object_thread_region_set(), in which case the caller creates one.
+Called by _create() functions.
+Thread-safe.
+*/
+Object* Object_recycled_take(const Class* cls);
+
+
+/** Records that cls's _create() function returns objects with the same classes and methods as self, so such objects can be kept for reuse.
+Called by _create() functions of classes with a reset() function.
+Thread-safe.
+*/
+void Object_recycle_register(const Class* cls, const Object* self);
+
+
+/** Returns the number of objects reused by Object_recycled_take(). */
+uint64_t Object_recycled_count_get(void);
+
+
+/** Creates an empty region. Never returns NULL. */
+__attribute__((warn_unused_result))
+ObjectRegion* Object_region_create(void);
+
+
+/** Creates an object with no classes whose shell and slot spill array are allocated from a region.
+The returned reference belongs to the region, which releases it in Object_region_destroy(), so don't unreference it.
+Other references obtained with Object_ref() must be unreferenced as usual, before the region is destroyed.
+The object may be freed before then if the region's reference is its last one and all others are released.
+If region is NULL, creates the object like Object_create().
+*/
+__attribute__((warn_unused_result))
+Object* Object_create_in(ObjectRegion* region);
+
+
+/** Releases the region's reference of each of its objects, runs the free() functions of the objects still alive, and releases the region's memory at once.
+References to the region's objects held outside of it are escapes, since they dangle afterwards.
+Unless the runtime is built with NDEBUG, escapes are reported on stderr and abort the program.
+Objects are freed on the calling thread, even if it defers unrefs with Object_thread_unref_deferred_set().
+Does nothing if region is NULL.
+*/
+void Object_region_destroy(ObjectRegion* region);
+
+
+/** Allocates memory from a region, such as an object's slot, aligned for any fundamental type.
+The memory is released by Object_region_destroy() and must not be passed to free().
+Returns NULL if region is NULL.
+*/
+void* Object_region_alloc(ObjectRegion* region, size_t size);
+
+
+/** Returns the region that the object was created in, or NULL. */
+ObjectRegion* Object_region_get(const Object* self);
+
+
+/** Sets the region that Object_create() creates objects in on the calling thread, including through the _create() functions of classes.
+Set to NULL to create objects normally again.
+*/
+void Object_thread_region_set(ObjectRegion* region);
+ObjectRegion* Object_thread_region_get(void);
+
+
 /** Increments the object's reference counter.
 Use this to share another reference to this object.
 Each reference must be unreferenced with Object_unref() to prevent a memory leak.
@@ -735,6 +952,7 @@ void Object_ref(const Object* self);
 
 /** Decrements the object's reference counter.
 If no references are left, this frees the object and its slot for each class.
+The runtime itself does not allocate memory while freeing, although free() functions may.
 Object should be considered invalid after calling this function.
 Thread-safe.
 Does nothing if self is NULL.
@@ -743,6 +961,45 @@ __attribute__((hot))
 void Object_unref(const Object* self);
 
 
+/** Merges the reference counts of objects owned by the calling thread that other threads have released, freeing those with no references left.
+Only needed when the runtime is built with OBJECT_BIASED_REFS, which counts the references held by an object's creating thread without atomic read-modify-writes.
+Objects released by other threads are otherwise freed when their owner next creates an object or exits.
+*/
+void Object_thread_refs_merge(void);
+
+
+/** Adds `count` strong references to the object in one atomic operation.
+Each reference must be unreferenced with Object_unref() to prevent a memory leak.
+Thread-safe.
+Does nothing if self is NULL or count is 0.
+*/
+void Object_refs_add(const Object* self, uint32_t count);
+
+
+/** Releases `count` strong references of the object in one atomic operation, like calling Object_unref() `count` times.
+Thread-safe.
+Does nothing if self is NULL or count is 0.
+*/
+void Object_refs_remove(const Object* self, uint32_t count);
+
+
+/** Calls Object_ref() on each object in an array.
+Adjacent duplicate pointers are counted with one atomic operation.
+NULL entries are skipped.
+Thread-safe.
+*/
+void Object_ref_array(const Object* const* objects, uint64_t count);
+
+
+/** Calls Object_unref() on each object in an array.
+Adjacent duplicate pointers are counted with one atomic operation.
+Objects whose last reference is released are freed in batches after their reference counts are decremented, rather than between decrements.
+NULL entries are skipped.
+Thread-safe.
+*/
+void Object_unref_array(const Object* const* objects, uint64_t count);
+
+
 /** Returns the number of strong references to the object.
 Returns 0 if self is NULL.
 Thread-safe.
@@ -783,18 +1040,107 @@ __attribute__((hot, warn_unused_result))
 bool Object_weak_lock(const Object* self);
 
 
+/** A compact weak reference to an object, allocated separately from the object.
+Unlike Object_weak_ref(), it doesn't keep the object's shell allocated, so the shell is freed as soon as the last strong reference is released.
+*/
+typedef struct ObjectWeak ObjectWeak;
+
+
+/** Returns the object's weak block, creating it on first use, and obtains a weak reference of it.
+Each weak reference must be unreferenced with ObjectWeak_unref().
+The caller must hold a strong reference.
+Returns NULL if self is NULL or is being freed.
+Thread-safe.
+*/
+ObjectWeak* ObjectWeak_get(const Object* self);
+/** Obtains another weak reference of the weak block.
+Does nothing if weak is NULL.
+*/
+void ObjectWeak_ref(ObjectWeak* weak);
+/** Releases a weak reference of the weak block, freeing it if none remain.
+Does nothing if weak is NULL.
+*/
+void ObjectWeak_unref(ObjectWeak* weak);
+
+
+/** Attempts to obtain a strong reference of the weak block's object.
+If successful, the caller must unreference it with Object_unref().
+Returns NULL if the object's strong references are gone, or if weak is NULL.
+Thread-safe.
+*/
+Object* ObjectWeak_lock(ObjectWeak* weak);
+/** Returns whether the weak block's object still has strong references, which may be stale under concurrent use. */
+bool ObjectWeak_alive_is(const ObjectWeak* weak);
+
+
+/** Identifies an object by an index into a global handle table and a generation, which is bumped when the object is freed.
+Can be copied and stored freely, such as in messages to other threads, undo histories, or scripting languages, without holding a reference.
+0 is the null handle.
+*/
+typedef uint64_t ObjectHandle;
+
+
+/** Returns the object's handle, allocating its handle table entry on first use.
+Returns the same handle until the object's strong references are gone.
+The caller must hold a strong reference.
+Returns 0 if self is NULL, if it is being freed, or if the handle table is full.
+Thread-safe.
+*/
+ObjectHandle Object_handle_get(const Object* self);
+
+
+/** Attempts to obtain a strong reference of the object identified by a handle.
+If successful, the caller must unreference it with Object_unref().
+Returns NULL if the object's strong references are gone, or if the handle is 0 or invalid.
+Lock-free and thread-safe.
+*/
+Object* Object_handle_lock(ObjectHandle handle);
+
+
+/** Returns whether the object identified by a handle still has strong references, which may be stale under concurrent use.
+Only reads the handle table, not the object.
+*/
+bool Object_handle_alive_is(ObjectHandle handle);
+
+
+/** Makes the object live until the program exits, and turns reference counting on it into a load and a branch with no write.
+Useful for global singletons referenced from many threads, since their reference counts no longer bounce a cache line between cores.
+Afterwards, Object_ref(), Object_unref(), and the weak reference functions do nothing, Object_weak_lock() always succeeds, and the reference count getters return UINT32_MAX.
+The object's free() functions are never called.
+The caller must hold a strong reference.
+Does nothing if self is NULL.
+Thread-safe.
+*/
+void Object_immortalize(const Object* self);
+bool Object_immortal_is(const Object* self);
+
+
 /** Sentinel slot for classes without per-instance state. Must not be dereferenced. */
 #define SLOT_NONE ((void*) -1)
 
 
 /** Assigns an object a class type with a slot pointer.
 slot must not be NULL. Pass SLOT_NONE for classes without per-instance state.
-Does nothing if self, cls, or slot is NULL, or if the class is already present.
+Does nothing if self, cls, or slot is NULL, if cls->slotSize is nonzero, since such classes are pushed with Object_classes_push_alloc(), or if the class is already present.
 Not thread-safe with any Object function on the same object.
 */
 void Object_classes_push(Object* self, const Class* cls, void* slot);
 
 
+/** Allocates a zeroed slot of cls->slotSize bytes and pushes the class with it, as with Object_classes_push().
+Slots are taken from per-thread pools by size class, or from the object's region if it has one, and are returned to the pools after the class's free() function returns.
+Returns the slot, or NULL if self or cls is NULL, cls->slotSize is 0, cls->slotAlign isn't a power of 2, or the class is already present.
+Not thread-safe with any Object function on the same object.
+*/
+void* Object_classes_push_alloc(Object* self, const Class* cls);
+
+
+/** Returns the number of live slots of a class allocated with Object_classes_push_alloc(). */
+uint64_t Object_class_slots_count_get(const Class* cls);
+/** Returns the number of bytes of live slots of a class allocated with Object_classes_push_alloc(), counting cls->slotSize per slot. */
+uint64_t Object_class_slots_bytes_get(const Class* cls);
+
+
 /** Returns the slot for self's class cls, or NULL if self is not of class cls.
 Returns NULL if self is NULL.
 Thread-safe with method calls and other reads on the same object.
@@ -811,6 +1157,22 @@ Not thread-safe with any Object function on the same object.
 void Object_classes_remove(Object* self, const Class* cls);
 
 
+/** Returns the number of classes of an object.
+Returns 0 if self is NULL.
+Thread-safe with method calls and other reads on the same object.
+Doesn't build the object's schema, so it is safe on real-time threads.
+*/
+uint64_t Object_classes_count_get(const Object* self);
+
+
+/** Returns an object's class at an index in push order, so index 0 is the first class pushed.
+Returns NULL if self is NULL or index is out of range.
+Thread-safe with method calls and other reads on the same object.
+Doesn't build the object's schema, so it is safe on real-time threads.
+*/
+const Class* Object_classes_get(const Object* self, uint64_t index);
+
+
 /** Overrides a method dispatched by the `dispatcher` function pointer.
 Not thread-safe with any Object function on the same object.
 */
@@ -835,6 +1197,243 @@ __attribute__((pure, hot))
 void* Object_supermethods_get(const Object* self, void* method);
 
 
+/** Builds the schema of the object's current classes and methods ahead of time.
+Schemas are otherwise built by the first method call or slot lookup after a class or method push, which allocates memory.
+Call this before handing an object to a real-time thread.
+Does nothing if self is NULL.
+Thread-safe with method calls and other reads on the same object.
+*/
+void Object_schema_prepare(const Object* self);
+
+
+/** Builds the schemas of several objects, like Object_schema_prepare().
+If depth is nonzero, also builds the schemas of class and method pushes up to `depth` pushes beyond each object's current state that other objects have already made, so specializing these objects along the same paths won't build schemas.
+Schemas prepared for paths that no object occupies may be freed by Object_schemaNodes_reclaim(), subject to Object_schemaNodes_retention_set().
+NULL objects are skipped.
+*/
+void Object_schemas_prepare(const Object* const* objects, uint64_t count, uint32_t depth);
+
+
+/** Generates a manifest of the class and method push paths whose schemas have been built, for replaying with Object_schemas_manifest_replay() in a later run.
+Classes are identified by `Class::name`, and dispatchers and methods by their symbol names, so they must be exported (link executables with `-rdynamic`).
+Paths through unexported functions are cut off before them.
+On Windows, symbols can't be looked up, so the manifest has no paths.
+Caller must free() the returned string.
+*/
+char* Object_schemas_manifest_export(void);
+
+
+/** Builds the schemas of each path in a manifest generated by Object_schemas_manifest_export(), so objects later specialized along those paths don't build schemas.
+Call this at startup before real-time threads start.
+Classes are resolved as the `<name>_class` symbol defined by DEFINE_CLASS().
+Lines whose classes or functions aren't loaded are skipped after building the part of their path before the missing symbol.
+Returns the number of paths fully replayed, which is always 0 on Windows.
+Replayed paths that no object occupies may be freed by Object_schemaNodes_reclaim(), subject to Object_schemaNodes_retention_set().
+*/
+uint64_t Object_schemas_manifest_replay(const char* manifest);
+
+
+/** Marks the calling thread as real-time, so schemas built lazily on it are counted by Object_realtimeBuilds_count_get().
+*/
+void Object_thread_realtime_set(bool realtime);
+bool Object_thread_realtime_get(void);
+
+
+/** Returns the number of schemas built lazily on threads marked real-time.
+Should stay 0 if objects are prepared with Object_schema_prepare() before real-time use.
+*/
+uint64_t Object_realtimeBuilds_count_get(void);
+
+
+/** If enabled, a schema built lazily on a thread marked real-time prints an error and aborts the program.
+Useful for catching missing Object_schema_prepare() calls in debug builds.
+Disabled by default.
+*/
+void Object_realtimeBuilds_abort_set(bool enabled);
+
+
+/** If enabled, lookups on an object whose schema isn't built yet walk its class and method push history without allocating, while a background thread builds the schema.
+Class pushes still build schemas on the calling thread.
+Useful when prepare calls can't cover every path reached by real-time threads.
+Disabled by default. Enabling starts the background thread, and disabling joins it.
+*/
+void Object_schemas_async_set(bool async);
+bool Object_schemas_async_get(void);
+
+
+/** Like Object_unref(), but if no references are left, queues the object to be freed by the reclaimer thread instead of calling its free() functions on the calling thread.
+Never allocates or blocks, so releasing the last reference takes bounded time on real-time threads.
+If the queue is full, frees the object on the calling thread and counts an overflow.
+Thread-safe.
+Does nothing if self is NULL.
+*/
+void Object_unref_deferred(const Object* self);
+
+
+/** If enabled, Object_unref() and Object_unref_array() on the calling thread behave like Object_unref_deferred().
+Disabled by default.
+*/
+void Object_thread_unref_deferred_set(bool deferred);
+bool Object_thread_unref_deferred_get(void);
+
+
+/** Starts a background thread that frees objects queued by deferred unrefs.
+Without it, queued objects are freed only by Object_deferred_reclaim().
+Does nothing if already started.
+*/
+void Object_reclaimer_start(void);
+
+
+/** Stops the reclaimer thread after it frees the objects queued so far.
+Does nothing if not started.
+*/
+void Object_reclaimer_stop(void);
+
+
+/** Frees the objects queued by deferred unrefs on the calling thread.
+Returns the number of objects freed.
+Thread-safe, and may run concurrently with the reclaimer thread.
+*/
+uint64_t Object_deferred_reclaim(void);
+
+
+/** Returns the number of objects waiting in the deferred unref queue. */
+uint64_t Object_deferred_depth_get(void);
+/** Returns the total number of objects freed from the deferred unref queue. */
+uint64_t Object_deferred_reclaimed_get(void);
+/** Returns the number of deferred unrefs that freed their object on the calling thread because the queue was full. */
+uint64_t Object_deferred_overflows_get(void);
+/** Returns the total and maximum time in nanoseconds between queueing and freeing deferred objects.
+Divide the total by Object_deferred_reclaimed_get() for the mean.
+*/
+uint64_t Object_deferred_latencyTotal_get(void);
+uint64_t Object_deferred_latencyMax_get(void);
+
+
+/** Releases a reference of each object, freeing the objects whose last references are released on a pool of threads.
+Objects released by free() functions are queued on the thread that released them, and idle threads steal them, so independent subgraphs are freed concurrently.
+Each object's classes are still freed in reverse order of specialization, but objects are freed in no particular order.
+Objects with a class flagged CLASS_FLAG_FREE_SERIAL are freed on the calling thread after the rest.
+Returns once all released objects are freed.
+The pool's threads are started by the first call and kept for later calls, which run one at a time.
+NULL entries are skipped.
+*/
+void Object_unref_parallel(const Object* const* roots, uint64_t count);
+
+
+/** Sets the number of threads used by Object_unref_parallel(), including the calling thread.
+0 means one per hardware thread, the default.
+*/
+void Object_parallel_threads_set(uint32_t threads);
+uint32_t Object_parallel_threads_get(void);
+
+
+/** Enters an RCU read-side section on the calling thread.
+Objects read with Object_rcu_read() inside the section stay alive until it ends, without changing their reference counts.
+Sections may be nested, and end at the outermost Object_rcu_read_unlock().
+Never blocks, but the thread's first call allocates its reader record.
+*/
+void Object_rcu_read_lock(void);
+void Object_rcu_read_unlock(void);
+
+
+/** Returns the object published in a variable, as a borrowed pointer that is valid until the calling thread's read-side section ends.
+Returns NULL if slot is NULL.
+*/
+__attribute__((hot))
+Object* Object_rcu_read(Object* const* slot);
+
+
+/** Publishes an object in a variable read with Object_rcu_read(), taking over the caller's reference.
+The previous object's reference is released once every read-side section that may have read it has ended, by a later publish, Object_rcu_reclaim(), Object_rcu_synchronize(), or the reclaimer thread started with Object_reclaimer_start().
+Thread-safe.
+Does nothing if slot is NULL.
+*/
+void Object_rcu_publish(Object** slot, Object* object);
+
+
+/** Releases a reference of an object that was unpublished from a variable read with Object_rcu_read(), once every read-side section that may have read it has ended.
+Object_rcu_publish() calls it with the previous object, and RcuRefT calls it for variables it stores itself.
+Does nothing if object is NULL.
+*/
+void Object_rcu_retire(const Object* object);
+
+
+/** Releases the unpublished objects that no read-side section can still read.
+Returns the number of objects still waiting.
+*/
+uint64_t Object_rcu_reclaim(void);
+
+
+/** Waits until every unpublished object is released.
+Does nothing if called inside a read-side section, since the wait would never end.
+*/
+void Object_rcu_synchronize(void);
+
+
+/** Limits the time that releasing an object on the calling thread spends freeing the objects released by its free() functions.
+When an object's last reference is released, objects whose last references are released by its free() functions are freed after it, one at a time, rather than recursively, so deep object graphs don't overflow the stack.
+Once the budget is spent, the remaining objects are left pending until Object_thread_frees_continue() or the thread's next release frees them.
+Pending objects can't be locked by weak references.
+Objects still pending when the thread exits are freed then.
+0 means no limit, the default.
+*/
+void Object_thread_free_budget_set(uint64_t nanoseconds);
+uint64_t Object_thread_free_budget_get(void);
+
+
+/** Frees objects left pending on the calling thread by its free budget, until the budget is spent again.
+Returns the number of objects still pending.
+*/
+uint64_t Object_thread_frees_continue(void);
+/** Returns the number of objects pending on the calling thread. */
+uint64_t Object_thread_frees_pending_get(void);
+
+
+/** Categories of memory that the runtime allocates, each with its own allocator and counters.
+*/
+typedef enum ObjectAllocCategory {
+	/** Object shells, allocated and freed on the hot path with each object. */
+	OBJECT_ALLOC_OBJECTS,
+	/** Slot spill arrays of objects with more than 4 classes, allocated on the hot path while specializing. */
+	OBJECT_ALLOC_SLOTS,
+	/** Schema nodes, schemas, and their hash tables, allocated on the cold path when a new class or method push history appears. */
+	OBJECT_ALLOC_SCHEMAS,
+	/** Weak blocks, handle table chunks, region chunks, per-thread records, and the runtime's tables and lists, such as the side table, recycle pools, and RCU retired list. */
+	OBJECT_ALLOC_RUNTIME,
+	OBJECT_ALLOC_CATEGORIES
+} ObjectAllocCategory;
+
+
+/** Allocation functions for a category, such as a TLSF pool, a huge-page arena, or a NUMA-local heap.
+Both functions must be thread-safe, and must not create or release objects.
+*/
+typedef struct ObjectAllocator {
+	/** Returns a block of at least `size` bytes aligned to `align`, a power of 2, or NULL on failure, which aborts the program. */
+	void* (*alloc)(void* context, size_t size, size_t align);
+	/** Frees a block returned by `alloc` with the same size and alignment. */
+	void (*free)(void* context, void* block, size_t size, size_t align);
+	void* context;
+} ObjectAllocator;
+
+
+/** Sets the allocator of a category, or restores the default global operator new and delete if allocator is NULL.
+Must be called before the runtime allocates memory of the category, usually at startup, since blocks must be freed by the allocator that allocated them.
+Returns false, leaving the allocator unchanged, if memory of the category is currently allocated, the category is invalid, or a function is NULL.
+Not thread-safe.
+Strings returned by Object_inspect() and Object_schemas_manifest_export() are still allocated with malloc(), since the caller frees them.
+*/
+bool Object_allocator_set(ObjectAllocCategory category, const ObjectAllocator* allocator);
+
+
+/** Returns the number of allocations made in a category.
+Each thread counts its own allocations, which are summed here, so counting doesn't slow down allocating.
+*/
+uint64_t Object_allocs_count_get(ObjectAllocCategory category);
+/** Returns the number of bytes currently allocated in a category. */
+uint64_t Object_allocs_bytes_get(ObjectAllocCategory category);
+
+
 /** Generates a string listing all type names and slots of an object in order of specialization.
 Returns NULL if self is NULL.
 Caller must free() the returned string.
@@ -855,4 +1454,32 @@ Useful for profiling and debugging.
 uint64_t Object_schemaNodes_count_get(void);
 
 
+/** Frees schema nodes that no object occupies and that have no descendants, and schemas that no schema node uses.
+Schema node memory is recycled for new schema nodes rather than returned to the system.
+Returns the number of bytes freed.
+Thread-safe, and never blocks lock-free readers, but waits for concurrent class and method pushes to finish their tree lookups.
+Should not be called from real-time threads.
+*/
+uint64_t Object_schemaNodes_reclaim(void);
+
+
+/** Number of consecutive Object_schemaNodes_reclaim() calls that must find a schema node unused before it is freed.
+Higher values keep schema nodes of briefly unused types, so recreating those types doesn't rebuild their schemas.
+Default is 1. Values above 65535 behave as 65535.
+*/
+uint32_t Object_schemaNodes_retention_get(void);
+void Object_schemaNodes_retention_set(uint32_t passes);
+
+
+/** Returns the total number of bytes freed by Object_schemaNodes_reclaim().
+*/
+uint64_t Object_schemaNodes_reclaimedBytes_get(void);
+
+
+/** Returns the number of distinct schemas, the resolved method and slot tables shared by schema nodes with equal contents.
+Useful for profiling and debugging.
+*/
+uint64_t Object_schemas_count_get(void);
+
+
 EXTERNC_END
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <vector>
+#include <atomic>
+#include <assert.h>
 #include "Object.h"
 
 
@@ -318,6 +321,321 @@ using WeakRef = WeakRefT<Object>;
 using ConstWeakRef = WeakRefT<const Object>;
 
 
+/** Holds a strong reference to an Object that can be loaded and replaced by several threads at once without locks, like `std::atomic<RefT<T>>`.
+The stored Object carries a batch of extra strong references, and load() takes one of them with a single atomic increment, so readers never block or retry.
+The pointer, the batch size, and the number of batch references taken share one 64-bit word, so Objects must lie below 2^48, which user-space addresses do unless the process maps memory above it explicitly.
+Batches shrink once an Object's strong count passes 2^30, so that many AtomicRefs to one Object don't overflow its count.
+Object_refs_get() of a stored Object includes its unused batch references.
+T can be `Object` or `const Object`.
+*/
+template<typename T = Object>
+struct AtomicRefT {
+	AtomicRefT() = default;
+
+	/** Takes over the reference of a RefT. */
+	AtomicRefT(RefT<T> ref) {
+		word.store(batch_acquire(ref.release()), std::memory_order_relaxed);
+	}
+
+	AtomicRefT(const AtomicRefT&) = delete;
+	AtomicRefT& operator=(const AtomicRefT&) = delete;
+
+	~AtomicRefT() {
+		batch_release(word.load(std::memory_order_relaxed), 0);
+	}
+
+	/** Obtains a new reference of the stored Object. */
+	RefT<T> load() const {
+		uint64_t w = word.fetch_add(takenOne, std::memory_order_acquire);
+		// Replenish the batch when half of it is taken, before it runs out
+		if ((w >> pointerBits) + 1 >= batch_get(w) / 2)
+			refill(w + takenOne);
+		return RefT<T>(pointer_get(w));
+	}
+
+	/** Replaces the stored Object, taking over the reference of `desired`, and returns the previous Object's reference. */
+	RefT<T> exchange(RefT<T> desired) {
+		uint64_t w = word.exchange(batch_acquire(desired.release()), std::memory_order_acq_rel);
+		return RefT<T>(batch_release(w, 1));
+	}
+
+	/** Replaces the stored Object, taking over the reference of `desired`. */
+	void store(RefT<T> desired) {
+		exchange(std::move(desired));
+	}
+
+	/** Replaces the stored Object with `desired` if it is `expected`.
+	Otherwise sets `expected` to a new reference of the stored Object.
+	Returns whether the Object was replaced.
+	*/
+	bool compare_exchange(RefT<T>& expected, const RefT<T>& desired) {
+		T* object = desired;
+		uint64_t desiredWord = word_get(object);
+		if (object)
+			Object_refs_add(object, batch_get(desiredWord));
+		uint64_t w = word.load(std::memory_order_relaxed);
+		while (pointer_get(w) == (T*) expected) {
+			if (word.compare_exchange_weak(w, desiredWord, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+				batch_release(w, 0);
+				return true;
+			}
+		}
+		if (object)
+			Object_refs_remove(object, batch_get(desiredWord));
+		expected = load();
+		return false;
+	}
+
+	operator RefT<T>() const { return load(); }
+
+private:
+	static_assert(sizeof(T*) <= sizeof(uint64_t), "AtomicRefT stores pointers in 64-bit words");
+
+	static const int pointerBits = 48;
+	/** Low 48 bits = Object pointer and batch shift. */
+	static const uint64_t addressMask = (uint64_t(1) << pointerBits) - 1;
+	/** Objects are aligned to Object_align_get(), at least 64 bytes, so the low bits of their address hold the batch shift. */
+	static const uint64_t shiftMask = 15;
+	static const uint64_t takenOne = uint64_t(1) << pointerBits;
+	/** Strong references of the stored Object held for load() are 1 << shift, with the shift in this range. */
+	static const int batchShiftMax = 15;
+	static const int batchShiftMin = 8;
+	/** Strong count beyond which new batches shrink, leaving the rest of the count's 31 bits to other references. */
+	static const uint32_t batchRefsLimit = uint32_t(1) << 30;
+
+	/** High 16 bits = batch references taken by load() since the batch was last replenished, middle bits = Object pointer, low 4 bits = batch shift. */
+	mutable std::atomic<uint64_t> word{batchShiftMax};
+
+	static T* pointer_get(uint64_t w) {
+		return (T*) uintptr_t(w & addressMask & ~shiftMask);
+	}
+
+	static uint32_t batch_get(uint64_t w) {
+		return uint32_t(1) << (w & shiftMask);
+	}
+
+	/** Returns the word storing an Object, with the largest batch that keeps its strong count within batchRefsLimit. */
+	static uint64_t word_get(T* object) {
+		uint64_t address = uint64_t(uintptr_t(object));
+		assert((address & ~addressMask) == 0 && (address & shiftMask) == 0);
+		if (!object)
+			return batchShiftMax;
+		uint64_t refs = Object_refs_get(object);
+		int shift = batchShiftMax;
+		// Immortal Objects have no count to overflow
+		if (refs != UINT32_MAX) {
+			while (shift > batchShiftMin && refs + (uint64_t(1) << shift) > batchRefsLimit)
+				shift--;
+		}
+		return address | uint64_t(shift);
+	}
+
+	/** Turns an adopted reference into a full batch, and returns the word storing the Object. */
+	static uint64_t batch_acquire(T* object) {
+		uint64_t w = word_get(object);
+		if (object)
+			Object_refs_add(object, batch_get(w) - 1);
+		return w;
+	}
+
+	/** Releases the unused batch references of a word that is no longer stored, except `keep` of them, and returns its Object. */
+	static T* batch_release(uint64_t w, uint32_t keep) {
+		T* object = pointer_get(w);
+		if (object)
+			Object_refs_remove(object, batch_get(w) - uint32_t(w >> pointerBits) - keep);
+		return object;
+	}
+
+	/** Adds back the batch references taken so far and resets the taken count, while the Object is still stored.
+	The caller holds a reference, so the Object can't be freed meanwhile.
+	*/
+	void refill(uint64_t w) const {
+		T* object = pointer_get(w);
+		uint64_t address = w & addressMask;
+		uint32_t added = 0;
+		while (true) {
+			uint32_t taken = w >> pointerBits;
+			if (taken > added) {
+				if (object)
+					Object_refs_add(object, taken - added);
+				added = taken;
+			}
+			if (word.compare_exchange_weak(w, address, std::memory_order_relaxed))
+				return;
+			// Another thread replaced the Object or replenished the batch first
+			if ((w & addressMask) != address || uint32_t(w >> pointerBits) < added) {
+				if (object)
+					Object_refs_remove(object, added);
+				return;
+			}
+		}
+	}
+};
+
+using AtomicRef = AtomicRefT<Object>;
+using ConstAtomicRef = AtomicRefT<const Object>;
+
+
+/** Holds an RCU read-side section using C++ RAII. */
+struct RcuReadLock {
+	RcuReadLock() {
+		Object_rcu_read_lock();
+	}
+
+	~RcuReadLock() {
+		Object_rcu_read_unlock();
+	}
+
+	RcuReadLock(const RcuReadLock&) = delete;
+	RcuReadLock& operator=(const RcuReadLock&) = delete;
+};
+
+
+/** Holds a strong reference to a published Object, which readers inside a read-side section can read without changing its reference count.
+Replaced Objects are released with Object_rcu_retire() once no reader can still see them.
+T can be `Object` or `const Object`.
+*/
+template<typename T = Object>
+struct RcuRefT {
+	RcuRefT() = default;
+
+	/** Takes over the reference of a RefT. */
+	RcuRefT(RefT<T> ref) : object(ref.release()) {}
+
+	RcuRefT(const RcuRefT&) = delete;
+	RcuRefT& operator=(const RcuRefT&) = delete;
+
+	~RcuRefT() {
+		Object_rcu_retire(object.exchange(NULL));
+	}
+
+	/** Returns a borrowed pointer to the published Object.
+	Must be called and used inside a read-side section, such as the lifetime of an RcuReadLock.
+	*/
+	T* get() const {
+		return object.load();
+	}
+
+	/** Returns the published Object with a new reference, which can outlive the read-side section.
+	*/
+	T* share() const {
+		RcuReadLock lock;
+		T* object = get();
+		if (object)
+			Object_ref(object);
+		return object;
+	}
+
+	/** Obtains a reference from a borrowed pointer and publishes it, replacing the current Object.
+	*/
+	void obtain(T* object) {
+		if (object)
+			Object_ref(object);
+		Object_rcu_retire(this->object.exchange(object));
+	}
+
+	/** Publishes a new Object, taking over the reference of a RefT. */
+	void publish(RefT<T> ref) {
+		Object_rcu_retire(object.exchange(ref.release()));
+	}
+
+private:
+	/** Sequentially consistent, like Object_rcu_read() and Object_rcu_publish(), so a reader's epoch is ordered with its loads. */
+	std::atomic<T*> object{NULL};
+};
+
+using RcuRef = RcuRefT<Object>;
+using ConstRcuRef = RcuRefT<const Object>;
+
+
+/** Holds a weak reference to an Object through its ObjectWeak block using C++ RAII.
+Unlike WeakRefT, it doesn't keep the Object's shell allocated after the Object is freed.
+*/
+struct WeakBlockRef {
+	WeakBlockRef() = default;
+
+	/** Obtains a weak reference of an Object, which the caller must hold a strong reference of. */
+	WeakBlockRef(const Object* object) : weak(ObjectWeak_get(object)) {}
+
+	WeakBlockRef(const WeakBlockRef& other) : weak(other.weak) {
+		ObjectWeak_ref(weak);
+	}
+
+	WeakBlockRef(WeakBlockRef&& other) : weak(other.weak) {
+		other.weak = NULL;
+	}
+
+	~WeakBlockRef() {
+		ObjectWeak_unref(weak);
+	}
+
+	WeakBlockRef& operator=(const WeakBlockRef& other) {
+		ObjectWeak_ref(other.weak);
+		ObjectWeak* old = weak;
+		weak = other.weak;
+		ObjectWeak_unref(old);
+		return *this;
+	}
+
+	WeakBlockRef& operator=(WeakBlockRef&& other) {
+		if (this != &other) {
+			ObjectWeak* old = weak;
+			weak = other.weak;
+			other.weak = NULL;
+			ObjectWeak_unref(old);
+		}
+		return *this;
+	}
+
+	/** Attempts to obtain a strong reference.
+	Returns an empty Ref if the Object has been freed.
+	*/
+	Ref lock() const {
+		return Ref(ObjectWeak_lock(weak));
+	}
+
+	explicit operator bool() const { return weak; }
+
+private:
+	ObjectWeak* weak = NULL;
+};
+
+
+/** Identifies an Object by its ObjectHandle, without holding a reference.
+Can be copied, compared, and hashed like an integer.
+*/
+struct HandleRef {
+	HandleRef() = default;
+
+	/** Gets the handle of an Object, which the caller must hold a strong reference of. */
+	HandleRef(const Object* object) : handle(Object_handle_get(object)) {}
+
+	explicit HandleRef(ObjectHandle handle) : handle(handle) {}
+
+	/** Attempts to obtain a strong reference.
+	Returns an empty Ref if the Object has been freed.
+	*/
+	Ref lock() const {
+		return Ref(Object_handle_lock(handle));
+	}
+
+	/** Returns whether the Object still has strong references, without reading the Object. */
+	bool alive() const {
+		return Object_handle_alive_is(handle);
+	}
+
+	ObjectHandle get() const { return handle; }
+
+	explicit operator bool() const { return handle; }
+	bool operator==(const HandleRef& other) const { return handle == other.handle; }
+	bool operator!=(const HandleRef& other) const { return handle != other.handle; }
+	bool operator<(const HandleRef& other) const { return handle < other.handle; }
+
+private:
+	ObjectHandle handle = 0;
+};
+
+
 /** Obtains a new strong reference from a borrowed pointer.
 */
 inline Ref obtain(Object* object) {
@@ -333,6 +651,121 @@ inline ConstRef obtain(const Object* object) {
 }
 
 
+/** Holds strong references to an array of Objects, like `std::vector<RefT<T>>`.
+Copies, clears, and resizes reference and unreference elements in bulk with Object_ref_array() and Object_unref_array().
+T can be `Object` or `const Object`.
+*/
+template<typename T = Object>
+struct RefVectorT {
+	RefVectorT() = default;
+
+	/** Obtains a new reference of each Object from another RefVectorT. */
+	RefVectorT(const RefVectorT& other) : objects(other.objects) {
+		Object_ref_array(objects.data(), objects.size());
+	}
+
+	RefVectorT(RefVectorT&& other) : objects(std::move(other.objects)) {
+		other.objects.clear();
+	}
+
+	~RefVectorT() {
+		clear();
+	}
+
+	RefVectorT& operator=(const RefVectorT& other) {
+		if (this != &other) {
+			Object_ref_array(other.objects.data(), other.objects.size());
+			std::vector<T*> old = std::move(objects);
+			objects = other.objects;
+			Object_unref_array(old.data(), old.size());
+		}
+		return *this;
+	}
+
+	RefVectorT& operator=(RefVectorT&& other) {
+		if (this != &other) {
+			std::vector<T*> old = std::move(objects);
+			objects = std::move(other.objects);
+			other.objects.clear();
+			Object_unref_array(old.data(), old.size());
+		}
+		return *this;
+	}
+
+	size_t size() const { return objects.size(); }
+	bool empty() const { return objects.empty(); }
+	void reserve(size_t capacity) { objects.reserve(capacity); }
+
+	/** Returns a borrowed pointer to an Object.
+	Does not obtain a new reference.
+	*/
+	T* operator[](size_t index) const { return objects[index]; }
+	T* const* data() const { return objects.data(); }
+	T* const* begin() const { return objects.data(); }
+	T* const* end() const { return objects.data() + objects.size(); }
+
+	/** Appends the Object of a RefT, obtaining a new reference. */
+	void push_back(const RefT<T>& ref) {
+		objects.push_back(ref.share());
+	}
+
+	/** Appends the Object of a RefT, moving its reference. */
+	void push_back(RefT<T>&& ref) {
+		objects.push_back(ref.release());
+	}
+
+	/** Removes the last element, transferring its reference to the returned RefT. */
+	RefT<T> pop_back() {
+		T* object = objects.back();
+		objects.pop_back();
+		return RefT<T>(object);
+	}
+
+	/** Obtains a reference from a borrowed pointer, replacing an element. */
+	void set(size_t index, T* object) {
+		if (object)
+			Object_ref(object);
+		T* old = objects[index];
+		objects[index] = object;
+		if (old)
+			Object_unref(old);
+	}
+
+	/** Resizes the array, unreferencing removed elements in bulk, or filling new elements with NULL. */
+	void resize(size_t size) {
+		resize(size, NULL);
+	}
+
+	/** Resizes the array, unreferencing removed elements in bulk, or filling new elements with references to an Object. */
+	void resize(size_t size, T* object) {
+		size_t oldSize = objects.size();
+		if (size < oldSize) {
+			std::vector<T*> removed(objects.begin() + size, objects.end());
+			objects.resize(size);
+			Object_unref_array(removed.data(), removed.size());
+		}
+		else if (size > oldSize) {
+			objects.resize(size, object);
+			Object_refs_add(object, uint32_t(size - oldSize));
+		}
+	}
+
+	/** Unreferences all elements in bulk. */
+	void clear() {
+		// Unreference after emptying, since free() functions may access this vector
+		std::vector<T*> old = std::move(objects);
+		objects.clear();
+		Object_unref_array(old.data(), old.size());
+	}
+
+private:
+	std::vector<T*> objects;
+};
+
+using RefVector = RefVectorT<Object>;
+using ConstRefVector = RefVectorT<const Object>;
+
+
 /** Similar to DEFINE_GETTER_SLOT() from Object.h for Object* properties stored as Ref or WeakRef.
 Returns a new Object* reference for the caller.
 */
@@ -376,3 +809,26 @@ Obtains a reference from the given borrowed Object*.
 #define DEFINE_GLOBAL_REF_ACCESSOR_VARIABLE(PREFIX, NAME, TYPE) \
 	DEFINE_GLOBAL_REF_GETTER_VARIABLE(PREFIX, NAME, TYPE) \
 	DEFINE_GLOBAL_REF_SETTER_VARIABLE(PREFIX, NAME, TYPE)
+
+/** Similar to DEFINE_GLOBAL_REF_GETTER_VARIABLE() for Object* globals stored as RcuRefT.
+Returns a borrowed Object*, which must be called and used inside a read-side section, such as the lifetime of an RcuReadLock.
+Reading doesn't change the Object's reference count.
+*/
+#define DEFINE_GLOBAL_RCU_GETTER_VARIABLE(PREFIX, NAME, TYPE) \
+	DEFINE_GLOBAL_GETTER(PREFIX, NAME, TYPE, { \
+		return NAME.get(); \
+	})
+
+/** Defines a borrowing RCU getter and a setter that obtains a reference from the given borrowed Object* and publishes it.
+
+Example:
+	static RcuRef preset;
+	DEFINE_GLOBAL_RCU_ACCESSOR_VARIABLE(zoo, preset, Object*)
+
+Defines:
+	Object* zoo_preset_get();
+	void zoo_preset_set(Object* preset);
+*/
+#define DEFINE_GLOBAL_RCU_ACCESSOR_VARIABLE(PREFIX, NAME, TYPE) \
+	DEFINE_GLOBAL_RCU_GETTER_VARIABLE(PREFIX, NAME, TYPE) \
+	DEFINE_GLOBAL_REF_SETTER_VARIABLE(PREFIX, NAME, TYPE)
@@ -23,14 +23,12 @@ struct Animal {
 };
 
 
-DEFINE_CLASS(Animal, (), (), {
-	Animal* slot = (Animal*) calloc(1, sizeof(Animal));
-	PUSH_CLASS(self, Animal, slot);
+DEFINE_CLASS_ALLOC(Animal, 0, (), (), {
+	PUSH_CLASS_ALLOC(self, Animal);
 	PUSH_METHOD(self, Animal, Animal, speak);
 	PUSH_ACCESSOR(self, Animal, Animal, legs);
 }, {
 	printf("bye Animal\n");
-	free(slot);
 })
 
 
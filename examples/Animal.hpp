@@ -24,14 +24,14 @@ struct Animal : ObjectProxy {
 	}
 
 	virtual void speak() const {
-		if (original)
-			CALL_DIRECT(self, Animal, speak);
+		if (bound_get())
+			CALL_DIRECT(self_get(), Animal, speak);
 		else
-			CALL(self, Animal, speak);
+			CALL(self_get(), Animal, speak);
 	}
 
 	void pet() {
-		CALL(self, Animal, pet);
+		CALL(self_get(), Animal, pet);
 	}
 
 	PROXY_ACCESSOR(Animal, Animal, legs, int);
@@ -48,10 +48,10 @@ struct Dog : Animal {
 	}
 
 	void speak() const override {
-		if (original)
-			CALL_DIRECT(self, Dog, speak);
+		if (bound_get())
+			CALL_DIRECT(self_get(), Dog, speak);
 		else
-			CALL(self, Animal, speak);
+			CALL(self_get(), Animal, speak);
 	}
 
 	PROXY_ACCESSOR(Dog, Dog, name, const char*);
@@ -65,7 +65,7 @@ struct Poodle : Dog {
 	}
 
 	void speak() const override {
-		printf("Yip yip yip yip yip yip %s!\n", GET(self, Dog, name));
+		printf("Yip yip yip yip yip yip %s!\n", GET(self_get(), Dog, name));
 	}
 };
 
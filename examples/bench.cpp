@@ -0,0 +1,317 @@
+/*
+Microbenchmarks of Object runtime reference counting.
+
+Run with `make bench`, which builds `bench-packed` with the default runtime, `bench-biased` with the runtime compiled with OBJECT_BIASED_REFS, and `bench-separate` with OBJECT_REFS_SEPARATE.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <Object/Object.h>
+
+
+static double now() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+static void report(const char* name, double seconds, uint64_t ops) {
+	printf("%-40s %8.2f ns/op\n", name, seconds / ops * 1e9);
+}
+
+
+/** Ref and unref an object on the thread that created it. */
+static void bench_owner(uint64_t iterations) {
+	Object* self = Object_create();
+	double start = now();
+	for (uint64_t i = 0; i < iterations; i++) {
+		Object_ref(self);
+		Object_unref(self);
+	}
+	report("ref/unref on creating thread", now() - start, iterations * 2);
+	Object_unref(self);
+}
+
+
+/** Ref and unref an object on a thread that didn't create it. */
+static void bench_other(uint64_t iterations) {
+	Object* self = Object_create();
+	std::thread([&]() {
+		double start = now();
+		for (uint64_t i = 0; i < iterations; i++) {
+			Object_ref(self);
+			Object_unref(self);
+		}
+		report("ref/unref on other thread", now() - start, iterations * 2);
+	}).join();
+	Object_unref(self);
+}
+
+
+/** Ref and unref one object from several threads at once. */
+static void bench_shared(uint64_t iterations, int threadCount) {
+	Object* self = Object_create();
+	std::vector<std::thread> threads;
+	double start = now();
+	for (int t = 0; t < threadCount; t++) {
+		threads.emplace_back([&]() {
+			for (uint64_t i = 0; i < iterations; i++) {
+				Object_ref(self);
+				Object_unref(self);
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	char name[64];
+	snprintf(name, sizeof(name), "ref/unref shared by %d threads", threadCount);
+	report(name, now() - start, iterations * 2);
+	Object_unref(self);
+}
+
+
+/** Ref and unref arrays of objects one at a time, then in bulk. */
+static void bench_array(uint64_t iterations, uint64_t size) {
+	std::vector<Object*> objects;
+	for (uint64_t i = 0; i < size; i++)
+		objects.push_back(Object_create());
+	// Repeat some entries, as in arrays copied from a few shared objects
+	for (uint64_t i = 0; i < size; i += 4)
+		objects[i + 1] = objects[i];
+
+	double start = now();
+	for (uint64_t j = 0; j < iterations; j++) {
+		for (Object* object : objects)
+			Object_ref(object);
+		for (Object* object : objects)
+			Object_unref(object);
+	}
+	report("ref/unref array element by element", now() - start, iterations * size * 2);
+
+	start = now();
+	for (uint64_t j = 0; j < iterations; j++) {
+		Object_ref_array(objects.data(), size);
+		Object_unref_array(objects.data(), size);
+	}
+	report("ref/unref array in bulk", now() - start, iterations * size * 2);
+
+	for (uint64_t i = 0; i < size; i += 4)
+		objects[i + 1] = NULL;
+	Object_unref_array(objects.data(), size);
+}
+
+
+/** Ref and unref one immortal object from several threads at once. */
+static void bench_immortal(uint64_t iterations, int threadCount) {
+	Object* self = Object_create();
+	Object_immortalize(self);
+	std::vector<std::thread> threads;
+	double start = now();
+	for (int t = 0; t < threadCount; t++) {
+		threads.emplace_back([&]() {
+			for (uint64_t i = 0; i < iterations; i++) {
+				Object_ref(self);
+				Object_unref(self);
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	char name[64];
+	snprintf(name, sizeof(name), "immortal ref/unref by %d threads", threadCount);
+	report(name, now() - start, iterations * 2);
+}
+
+
+static const Class Bench_class = {"Bench", NULL, 0, NULL, 0, 0, {}};
+static int benchSlot;
+static void bench_dispatcher() {}
+static void bench_method() {}
+
+
+/** Call methods and look up slots on one object from several threads, optionally while another thread refs and unrefs it.
+With the default layout, the ref traffic invalidates the cache line that every dispatch reads.
+*/
+static void bench_dispatch(uint64_t iterations, int threadCount, bool refTraffic) {
+	Object* self = Object_create();
+	Object_classes_push(self, &Bench_class, &benchSlot);
+	Object_methods_push(self, (void*) &bench_dispatcher, (void*) &bench_method);
+	Object_schema_prepare(self);
+
+	std::atomic<bool> done{false};
+	std::thread refThread;
+	if (refTraffic) {
+		refThread = std::thread([&]() {
+			while (!done.load(std::memory_order_relaxed)) {
+				Object_ref(self);
+				Object_unref(self);
+			}
+		});
+	}
+
+	std::vector<std::thread> threads;
+	std::atomic<uint64_t> misses{0};
+	double start = now();
+	for (int t = 0; t < threadCount; t++) {
+		threads.emplace_back([&]() {
+			uint64_t m = 0;
+			for (uint64_t i = 0; i < iterations; i++) {
+				if (Object_methods_get(self, (void*) &bench_dispatcher) != (void*) &bench_method)
+					m++;
+				if (Object_slots_get(self, &Bench_class) != &benchSlot)
+					m++;
+			}
+			misses += m;
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	double seconds = now() - start;
+	done = true;
+	if (refTraffic)
+		refThread.join();
+
+	char name[64];
+	snprintf(name, sizeof(name), "dispatch by %d threads%s", threadCount, refTraffic ? ", ref traffic" : "");
+	report(name, seconds, iterations * 2);
+	if (misses > 0)
+		printf("dispatch returned wrong results\n");
+	Object_unref(self);
+}
+
+
+/** Create and free objects, each referenced a few times by its creator. */
+static void bench_lifetime(uint64_t iterations) {
+	double start = now();
+	for (uint64_t i = 0; i < iterations; i++) {
+		Object* self = Object_create();
+		Object_ref(self);
+		Object_ref(self);
+		Object_unref(self);
+		Object_unref(self);
+		Object_unref(self);
+	}
+	report("create, 3 unrefs, free", now() - start, iterations);
+}
+
+
+struct BenchVoice {
+	int note;
+};
+
+DEFINE_CLASS_RECYCLED(BenchVoice, 0, (), (), {
+	BenchVoice* slot = (BenchVoice*) calloc(1, sizeof(BenchVoice));
+	PUSH_CLASS(self, BenchVoice, slot);
+}, {
+	slot->note = 0;
+}, {
+	free(slot);
+})
+
+
+/** Create and release objects of a class with a reset() function, freeing them and then recycling them. */
+static void bench_recycle(uint64_t iterations) {
+	for (uint32_t capacity : {0, 64}) {
+		Object_recycle_capacity_set(capacity);
+		double start = now();
+		for (uint64_t i = 0; i < iterations; i++) {
+			Object* self = BenchVoice_create();
+			Object_unref(self);
+		}
+		report(capacity ? "create/release, recycled" : "create/release, freed", now() - start, iterations);
+	}
+	Object_recycle_capacity_set(0);
+}
+
+
+struct BenchNote {
+	int pitch;
+};
+
+DEFINE_CLASS_ALLOC(BenchNote, 0, (), (), {
+	PUSH_CLASS_ALLOC(self, BenchNote);
+}, {})
+
+
+/** Create and free objects whose slot is allocated with calloc(), then by the runtime from its slot pools. */
+static void bench_slot_alloc(uint64_t iterations) {
+	double start = now();
+	for (uint64_t i = 0; i < iterations; i++) {
+		Object* self = BenchVoice_create();
+		Object_unref(self);
+	}
+	report("create/free, calloc slot", now() - start, iterations);
+
+	start = now();
+	for (uint64_t i = 0; i < iterations; i++) {
+		Object* self = BenchNote_create();
+		Object_unref(self);
+	}
+	report("create/free, pooled slot", now() - start, iterations);
+}
+
+
+/** Lock a weak reference and release the strong reference from several threads at once.
+Compares Object_weak_lock(), which increments unconditionally, with a compare-and-swap loop that increments only if the count is nonzero.
+*/
+static void bench_weak_lock(uint64_t iterations, int threadCount) {
+	Object* self = Object_create();
+	Object_weak_ref(self);
+	std::vector<std::thread> threads;
+	double start = now();
+	for (int t = 0; t < threadCount; t++) {
+		threads.emplace_back([&]() {
+			for (uint64_t i = 0; i < iterations; i++) {
+				if (Object_weak_lock(self))
+					Object_unref(self);
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	char name[64];
+	snprintf(name, sizeof(name), "weak lock/unref by %d threads", threadCount);
+	report(name, now() - start, iterations * threadCount);
+	Object_unref(self);
+	Object_weak_unref(self);
+
+	alignas(64) std::atomic<uint64_t> refs{1};
+	threads.clear();
+	start = now();
+	for (int t = 0; t < threadCount; t++) {
+		threads.emplace_back([&]() {
+			for (uint64_t i = 0; i < iterations; i++) {
+				uint64_t r = refs.load(std::memory_order_relaxed);
+				while (r > 0 && !refs.compare_exchange_weak(r, r + 1, std::memory_order_acquire, std::memory_order_relaxed)) {}
+				if (r > 0)
+					refs.fetch_sub(1, std::memory_order_release);
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	snprintf(name, sizeof(name), "CAS loop lock/unref by %d threads", threadCount);
+	report(name, now() - start, iterations * threadCount);
+}
+
+
+int main() {
+	const uint64_t iterations = 20000000;
+	bench_owner(iterations);
+	bench_other(iterations);
+	bench_shared(iterations / 4, 4);
+	bench_immortal(iterations / 4, 4);
+	bench_array(iterations / 10000, 10000);
+	bench_dispatch(iterations / 4, 3, false);
+	bench_dispatch(iterations / 4, 3, true);
+	bench_lifetime(iterations / 10);
+	bench_recycle(iterations / 10);
+	bench_slot_alloc(iterations / 10);
+	for (int threadCount = 1; threadCount <= 64; threadCount *= 2)
+		bench_weak_lock(iterations / 20 / threadCount, threadCount);
+	return 0;
+}
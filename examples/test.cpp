@@ -2,10 +2,140 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <Object/Ref.hpp>
 #include "Animal.hpp"
 
 
+// A quiet recyclable class for the runtime examples, counting its frees
+struct Counter {
+	int n;
+};
+
+static std::atomic<int> counterFrees{0};
+
+DEFINE_CLASS_RECYCLED(Counter, 0, (), (), {
+	Counter* slot = (Counter*) calloc(1, sizeof(Counter));
+	PUSH_CLASS(self, Counter, slot);
+}, {
+	slot->n = 0;
+}, {
+	counterFrees++;
+	free(slot);
+})
+
+
+// A list node, whose release releases the rest of the list
+struct Link {
+	Object* next;
+};
+
+DEFINE_CLASS(Link, (Object* next), (next), {
+	Link* slot = (Link*) calloc(1, sizeof(Link));
+	slot->next = next;
+	PUSH_CLASS(self, Link, slot);
+}, {
+	Object_unref(slot->next);
+	free(slot);
+})
+
+
+// A class whose free() must run on the thread that releases the graph
+struct Pinned {
+	int unused;
+};
+
+static std::thread::id releasingThread;
+static std::atomic<int> pinnedElsewhere{0};
+
+DEFINE_CLASS_FLAGS(Pinned, CLASS_FLAG_FREE_SERIAL, (), (), {
+	Pinned* slot = (Pinned*) calloc(1, sizeof(Pinned));
+	PUSH_CLASS(self, Pinned, slot);
+}, {
+	if (std::this_thread::get_id() != releasingThread)
+		pinnedElsewhere++;
+	free(slot);
+})
+
+// A binary tree node, with some nodes also Pinned
+struct Branch {
+	Object* left;
+	Object* right;
+};
+
+static std::atomic<int> branchFrees{0};
+
+CLASS(Branch, (int depth));
+
+DEFINE_CLASS(Branch, (int depth), (depth), {
+	Branch* slot = (Branch*) calloc(1, sizeof(Branch));
+	if (depth > 0) {
+		slot->left = Branch_create(depth - 1);
+		slot->right = Branch_create(depth - 1);
+	}
+	PUSH_CLASS(self, Branch, slot);
+	if (depth == 2)
+		Pinned_specialize(self);
+}, {
+	branchFrees++;
+	Object_unref(slot->left);
+	Object_unref(slot->right);
+	free(slot);
+})
+
+
+// A global published with RCU, whose getter returns a borrowed pointer valid inside a read-side section
+static RcuRef preset;
+DEFINE_GLOBAL_RCU_ACCESSOR_VARIABLE(test, preset, Object*)
+
+
+// An allocator that counts the bytes it hands out
+static std::atomic<int64_t> countingBytes{0};
+
+static void* counting_alloc(void* context, size_t size, size_t align) {
+	(void) context;
+	countingBytes += size;
+	return aligned_alloc(align, (size + align - 1) / align * align);
+}
+
+static void counting_free(void* context, void* block, size_t size, size_t align) {
+	(void) context;
+	(void) align;
+	countingBytes -= size;
+	free(block);
+}
+
+
 int main() {
+	// Allocator example
+	printf("\nAllocator example\n");
+
+	{
+		// Allocators are replaced at startup, before the runtime allocates memory of their category
+		ObjectAllocator counting = {counting_alloc, counting_free, NULL};
+		assert(Object_allocator_set(OBJECT_ALLOC_OBJECTS, &counting));
+		uint64_t allocs = Object_allocs_count_get(OBJECT_ALLOC_OBJECTS);
+		Object* animal = Animal_create();
+		assert(Object_allocs_count_get(OBJECT_ALLOC_OBJECTS) == allocs + 1);
+		assert(countingBytes > 0 && Object_allocs_bytes_get(OBJECT_ALLOC_OBJECTS) == (uint64_t) countingBytes);
+		// An allocator can't be replaced while its blocks are in use
+		assert(!Object_allocator_set(OBJECT_ALLOC_OBJECTS, NULL));
+		Object_unref(animal);
+		assert(countingBytes == 0 && Object_allocs_bytes_get(OBJECT_ALLOC_OBJECTS) == 0);
+		// Allocations on other threads are counted too
+		std::thread([] {
+			Object_unref(Animal_create());
+		}).join();
+		assert(Object_allocs_count_get(OBJECT_ALLOC_OBJECTS) == allocs + 2);
+		// Restore the default allocator
+		assert(Object_allocator_set(OBJECT_ALLOC_OBJECTS, NULL));
+	}
+
+
+
 	// C Animal example
 	printf("\nC Animal example\n");
 
@@ -52,5 +182,747 @@ int main() {
 	assert(GET(dog, Object, refs) == 1);
 	Object_unref(dog);
 
+
+
+	// Class introspection example
+	printf("\nClass introspection example\n");
+
+	{
+		Object* rex = Dog_create("Rex");
+		// Classes are listed in push order
+		assert(Object_classes_count_get(rex) == 2);
+		assert(Object_classes_get(rex, 0) == &Animal_class);
+		assert(Object_classes_get(rex, 1) == &Dog_class);
+		assert(!Object_classes_get(rex, 2));
+		Object_unref(rex);
+	}
+
+	{
+		// A method push leaves the object on a node whose schema is built lazily
+		Object* counter = Counter_create();
+		PUSH_METHOD(counter, Animal, Dog, speak);
+		// Listing classes doesn't build it, so real-time threads can introspect objects
+		Object_thread_realtime_set(true);
+		uint64_t builds = Object_realtimeBuilds_count_get();
+		assert(Object_classes_count_get(counter) == 1);
+		assert(Object_classes_get(counter, 0) == &Counter_class);
+		assert(Object_realtimeBuilds_count_get() == builds);
+		Object_thread_realtime_set(false);
+		Object_unref(counter);
+	}
+
+
+
+	// Schema deduplication example
+	printf("\nSchema deduplication example\n");
+
+	{
+		// Any distinct addresses can serve as dispatchers and methods
+		static int dispatchers[2], methods[2];
+		Object* first = Counter_create();
+		Object_methods_push(first, &dispatchers[0], &methods[0]);
+		Object_methods_push(first, &dispatchers[1], &methods[1]);
+		assert(Object_methods_get(first, &dispatchers[0]) == &methods[0]);
+		uint64_t schemas = Object_schemas_count_get();
+		// Pushing the same methods in the other order gives equal contents, which share the first object's schema
+		Object* second = Counter_create();
+		Object_methods_push(second, &dispatchers[1], &methods[1]);
+		Object_methods_push(second, &dispatchers[0], &methods[0]);
+		assert(Object_methods_get(second, &dispatchers[1]) == &methods[1]);
+		assert(Object_schemas_count_get() == schemas);
+		Object_unref(first);
+		Object_unref(second);
+	}
+
+
+
+	// Schema reclamation example
+	printf("\nSchema reclamation example\n");
+
+	{
+		// Keep an object on the class's node, so only the method push nodes below it become unused
+		Object* keep = Counter_create();
+		Object_schemaNodes_reclaim();
+		uint64_t nodes = Object_schemaNodes_count_get();
+		uint64_t reclaimedBytes = Object_schemaNodes_reclaimedBytes_get();
+		// Per-instance method pushes leave nodes behind once their objects are freed
+		static int dispatchers[16], methods[16];
+		for (int i = 0; i < 16; i++) {
+			Object* counter = Counter_create();
+			Object_methods_push(counter, &dispatchers[i], &methods[i]);
+			assert(Object_methods_get(counter, &dispatchers[i]) == &methods[i]);
+			Object_unref(counter);
+		}
+		assert(Object_schemaNodes_count_get() == nodes + 16);
+		uint64_t bytes = Object_schemaNodes_reclaim();
+		assert(bytes > 0 && Object_schemaNodes_reclaimedBytes_get() == reclaimedBytes + bytes);
+		assert(Object_schemaNodes_count_get() == nodes);
+
+		// Retention keeps unused nodes for a number of reclaim passes, for objects that come back soon
+		Object_schemaNodes_retention_set(2);
+		assert(Object_schemaNodes_retention_get() == 2);
+		Object* counter = Counter_create();
+		Object_methods_push(counter, &dispatchers[0], &methods[0]);
+		Object_unref(counter);
+		Object_schemaNodes_reclaim();
+		assert(Object_schemaNodes_count_get() == nodes + 1);
+		Object_schemaNodes_reclaim();
+		assert(Object_schemaNodes_count_get() == nodes);
+		Object_schemaNodes_retention_set(1);
+		Object_unref(keep);
+	}
+
+
+
+	// Schema preparation example
+	printf("\nSchema preparation example\n");
+
+	{
+		static int dispatcher, method, lateDispatcher, lateMethod;
+		// Preparing builds an object's schema before it is handed to a real-time thread
+		Object* counter = Counter_create();
+		Object_methods_push(counter, &dispatcher, &method);
+		Object_schema_prepare(counter);
+		// Preparing objects with a depth also builds the schemas of the nodes their objects may move to
+		Object* other = Counter_create();
+		const Object* objects[] = {other};
+		Object_schemas_prepare(objects, 1, 1);
+
+		Object_thread_realtime_set(true);
+		assert(Object_thread_realtime_get());
+		uint64_t builds = Object_realtimeBuilds_count_get();
+		Object_methods_push(other, &dispatcher, &method);
+		assert(Object_methods_get(counter, &dispatcher) == &method);
+		assert(Object_methods_get(other, &dispatcher) == &method);
+		assert(Object_realtimeBuilds_count_get() == builds);
+		// Schemas that weren't prepared are built lazily and counted
+		Object_methods_push(other, &lateDispatcher, &lateMethod);
+		assert(Object_methods_get(other, &lateDispatcher) == &lateMethod);
+		assert(Object_realtimeBuilds_count_get() == builds + 1);
+		Object_thread_realtime_set(false);
+		Object_unref(counter);
+		Object_unref(other);
+	}
+
+
+
+	// Asynchronous schema example
+	printf("\nAsynchronous schema example\n");
+
+	{
+		static int dispatcher, method, overrideMethod;
+		Object_schemas_async_set(true);
+		assert(Object_schemas_async_get());
+		Object* counter = Counter_create();
+		Object_methods_push(counter, &dispatcher, &method);
+		Object_methods_push(counter, &dispatcher, &overrideMethod);
+		uint64_t schemas = Object_schemas_count_get();
+		// First lookups walk the node chain while a background thread builds the schema
+		Object_thread_realtime_set(true);
+		uint64_t builds = Object_realtimeBuilds_count_get();
+		assert(Object_methods_get(counter, &dispatcher) == &overrideMethod);
+		assert(Object_supermethods_get(counter, &overrideMethod) == &method);
+		assert(Object_slots_get(counter, &Counter_class));
+		assert(!Object_slots_get(counter, &Animal_class));
+		assert(Object_realtimeBuilds_count_get() == builds);
+		Object_thread_realtime_set(false);
+		// Later lookups use the built schema
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (Object_schemas_count_get() == schemas && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::yield();
+		assert(Object_schemas_count_get() == schemas + 1);
+		assert(Object_methods_get(counter, &dispatcher) == &overrideMethod);
+		Object_schemas_async_set(false);
+		assert(!Object_schemas_async_get());
+		Object_unref(counter);
+	}
+
+
+
+	// Schema manifest example
+#if !defined _WIN32
+	printf("\nSchema manifest example\n");
+
+	{
+		Object* rex = Dog_create("Rex");
+		// Dog's push path is listed by class names and method symbols
+		char* manifest = Object_schemas_manifest_export();
+		assert(strstr(manifest, "C:Animal") && strstr(manifest, "C:Dog"));
+		assert(strstr(manifest, "Dog_speak"));
+		// Replaying the path in a later run builds its schemas before any Dog is created
+		assert(Object_schemas_manifest_replay(manifest) >= 1);
+		assert(Object_schemas_manifest_replay("C:NoSuchClass\n") == 0);
+		free(manifest);
+		Object_unref(rex);
+	}
+#endif
+
+
+
+	// Cross-thread reference example
+	printf("\nCross-thread reference example\n");
+
+	{
+		// Biased builds count the creating thread's references apart from other threads' references, and merge them when needed
+		uint64_t alive = Object_alive_get();
+		int frees = counterFrees;
+		Object* counter = Counter_create();
+		std::thread([&] {
+			Object_ref(counter);
+			Object_unref(counter);
+			// Another thread can release the creating thread's reference
+			Object_unref(counter);
+		}).join();
+		Object_thread_refs_merge();
+		assert(Object_alive_get() == alive && counterFrees == frees + 1);
+
+		// The creating thread can exit before its object is released
+		counter = NULL;
+		std::thread([&] {
+			counter = Counter_create();
+			Object_ref(counter);
+		}).join();
+		assert(Object_refs_get(counter) == 2);
+		Object_unref(counter);
+		Object_unref(counter);
+		assert(Object_alive_get() == alive && counterFrees == frees + 2);
+
+		// Threads share an object with the creating thread
+		counter = Counter_create();
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; t++) {
+			threads.emplace_back([&] {
+				for (int i = 0; i < 100000; i++) {
+					Object_ref(counter);
+					Object_unref(counter);
+				}
+			});
+		}
+		for (int i = 0; i < 100000; i++) {
+			Object_ref(counter);
+			Object_unref(counter);
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+		assert(Object_refs_get(counter) == 1);
+		Object_unref(counter);
+		assert(Object_alive_get() == alive && counterFrees == frees + 3);
+	}
+
+
+
+	// Immortal object example
+	printf("\nImmortal object example\n");
+
+	{
+		// Immortal objects, such as shared constants, skip reference counting and are never freed
+		static Object* constant = Counter_create();
+		Object_immortalize(constant);
+		assert(Object_immortal_is(constant) && !Object_immortal_is(NULL));
+		uint64_t alive = Object_alive_get();
+		int frees = counterFrees;
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; t++) {
+			threads.emplace_back([] {
+				for (int i = 0; i < 10000; i++) {
+					Object_ref(constant);
+					Object_unref(constant);
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+		Object_unref(constant);
+		Object_unref(constant);
+		assert(Object_alive_get() == alive && counterFrees == frees);
+		assert(Object_refs_get(constant) == UINT32_MAX);
+		assert(Object_slots_get(constant, &Counter_class));
+	}
+
+
+
+	// Batched reference example
+	printf("\nBatched reference example\n");
+
+	{
+		int frees = counterFrees;
+		Object* a = Counter_create();
+		Object* b = Counter_create();
+		// Several references are added in one atomic operation
+		Object_refs_add(a, 3);
+		assert(Object_refs_get(a) == 4);
+		// Adjacent duplicates in an array are counted together, and NULL entries are skipped
+		const Object* objects[] = {a, a, a, NULL, b, b, a};
+		Object_ref_array(objects, 7);
+		assert(Object_refs_get(a) == 8 && Object_refs_get(b) == 3);
+		Object_unref_array(objects, 7);
+		assert(Object_refs_get(a) == 4 && Object_refs_get(b) == 1);
+		const Object* last[] = {a, a, a, a, b};
+		Object_unref_array(last, 5);
+		assert(counterFrees == frees + 2);
+	}
+
+	{
+		// RefVector holds a reference of each element, and copies them in batches
+		int frees = counterFrees;
+		Ref shared(Counter_create());
+		{
+			RefVector counters;
+			for (int i = 0; i < 10; i++)
+				counters.push_back(shared);
+			assert(Object_refs_get(shared) == 11);
+			RefVector copy = counters;
+			assert(Object_refs_get(shared) == 21);
+			copy.resize(2);
+			assert(Object_refs_get(shared) == 13);
+			copy.clear();
+			assert(Object_refs_get(shared) == 11);
+		}
+		assert(Object_refs_get(shared) == 1 && counterFrees == frees);
+	}
+
+	{
+		uint64_t alive = Object_alive_get();
+		int frees = counterFrees;
+		Object* counter = Counter_create();
+		// A reference obtained on another thread, which biased builds count apart from the creating thread's
+		std::thread([&] {
+			Object_ref(counter);
+		}).join();
+		// Duplicates are released together, so one release can exceed either thread's count
+		const Object* pair[2] = {counter, counter};
+		Object_unref_array(pair, 2);
+		assert(Object_alive_get() == alive && counterFrees == frees + 1);
+
+		counter = Counter_create();
+		Object_refs_add(counter, 3);
+		std::thread([&] {
+			Object_ref(counter);
+		}).join();
+		Object_refs_remove(counter, 5);
+		assert(Object_alive_get() == alive && counterFrees == frees + 2);
+	}
+
+
+
+	// Deferred release example
+	printf("\nDeferred release example\n");
+
+	{
+		int frees = counterFrees;
+		uint64_t reclaimed = Object_deferred_reclaimed_get();
+		uint64_t overflows = Object_deferred_overflows_get();
+		Object* counter = Counter_create();
+		// The object is freed later, by Object_deferred_reclaim() or the reclaimer thread
+		Object_unref_deferred(counter);
+		assert(counterFrees == frees && Object_deferred_depth_get() == 1);
+		assert(Object_deferred_reclaim() == 1);
+		assert(counterFrees == frees + 1 && Object_deferred_depth_get() == 0);
+		assert(Object_deferred_reclaimed_get() == reclaimed + 1);
+
+		// Threads that defer their releases, such as real-time threads, leave the frees to the reclaimer thread
+		Object_reclaimer_start();
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; t++) {
+			threads.emplace_back([] {
+				Object_thread_unref_deferred_set(true);
+				assert(Object_thread_unref_deferred_get());
+				for (int i = 0; i < 1000; i++)
+					Object_unref(Counter_create());
+			});
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+		Object_reclaimer_stop();
+		Object_deferred_reclaim();
+		assert(counterFrees == frees + 4001);
+		// Releases that find the queue full are freed immediately instead
+		assert(Object_deferred_reclaimed_get() + Object_deferred_overflows_get() == reclaimed + overflows + 4001);
+		assert(Object_deferred_latencyMax_get() <= Object_deferred_latencyTotal_get());
+	}
+
+
+
+	// Deep release example
+	printf("\nDeep release example\n");
+
+	{
+		// Releasing the head of a long list frees the list iteratively rather than recursing
+		uint64_t alive = Object_alive_get();
+		Object* head = NULL;
+		for (int i = 0; i < 1000000; i++)
+			head = Link_create(head);
+		Object_unref(head);
+		assert(Object_alive_get() == alive);
+
+		// With a time budget, a release leaves the frees that don't fit pending for later
+		head = NULL;
+		for (int i = 0; i < 200000; i++)
+			head = Link_create(head);
+		Object_thread_free_budget_set(100000);
+		assert(Object_thread_free_budget_get() == 100000);
+		Object_unref(head);
+		assert(Object_thread_frees_pending_get() > 0);
+		while (Object_thread_frees_continue() > 0) {}
+		Object_thread_free_budget_set(0);
+		assert(Object_thread_frees_pending_get() == 0 && Object_alive_get() == alive);
+	}
+
+
+
+	// Parallel release example
+	printf("\nParallel release example\n");
+
+	{
+		// Large graphs are freed by several threads, except classes flagged CLASS_FLAG_FREE_SERIAL, which are freed on the calling thread
+		uint64_t alive = Object_alive_get();
+		int frees = branchFrees;
+		releasingThread = std::this_thread::get_id();
+		Object* roots[4];
+		for (Object*& root : roots)
+			root = Branch_create(12);
+		Object_parallel_threads_set(4);
+		assert(Object_parallel_threads_get() == 4);
+		Object_unref_parallel(roots, 4);
+		assert(branchFrees == frees + 4 * ((1 << 13) - 1));
+		assert(pinnedElsewhere == 0);
+		assert(Object_alive_get() == alive);
+		// The threads are reused across calls and thread counts
+		for (int round = 0; round < 20; round++) {
+			Object_parallel_threads_set(2 + round % 3);
+			Object* small[8];
+			for (Object*& root : small)
+				root = Branch_create(4);
+			Object_unref_parallel(small, 8);
+			assert(Object_alive_get() == alive);
+		}
+		Object_parallel_threads_set(0);
+	}
+
+
+
+	// Weak reference example
+	printf("\nWeak reference example\n");
+
+	{
+		Object* counter = Counter_create();
+		ObjectWeak* weak = ObjectWeak_get(counter);
+		ObjectHandle handle = Object_handle_get(counter);
+		assert(weak && handle);
+		// Locking obtains a strong reference while the object is alive
+		Object* locked = ObjectWeak_lock(weak);
+		assert(locked == counter);
+		Object_unref(locked);
+		locked = Object_handle_lock(handle);
+		assert(locked == counter);
+		Object_unref(locked);
+
+		int frees = counterFrees;
+		Object_unref(counter);
+		assert(counterFrees == frees + 1);
+		// The weak block and handle outlive the object, and locking them fails
+		assert(!ObjectWeak_alive_is(weak) && !ObjectWeak_lock(weak));
+		assert(!Object_handle_alive_is(handle) && !Object_handle_lock(handle));
+		ObjectWeak_unref(weak);
+	}
+
+	{
+		// Threads lock weak references while the last strong reference is released
+		int frees = counterFrees;
+		for (int round = 0; round < 200; round++) {
+			Object* counter = Counter_create();
+			Object_weak_ref(counter);
+			ObjectHandle handle = Object_handle_get(counter);
+			std::atomic<int> started{0};
+			std::vector<std::thread> threads;
+			for (int t = 0; t < 4; t++) {
+				threads.emplace_back([&] {
+					started++;
+					// Each successful lock sees a live slot, and the loop ends once the object is gone
+					while (true) {
+						bool weakLocked = Object_weak_lock(counter);
+						if (weakLocked) {
+							assert(Object_slots_get(counter, &Counter_class));
+							Object_unref(counter);
+						}
+						Object* locked = Object_handle_lock(handle);
+						if (locked) {
+							assert(Object_slots_get(locked, &Counter_class));
+							Object_unref(locked);
+						}
+						if (!weakLocked && !locked)
+							break;
+					}
+				});
+			}
+			while (started < 4)
+				std::this_thread::yield();
+			Object_unref(counter);
+			for (std::thread& thread : threads)
+				thread.join();
+			assert(!Object_weak_lock(counter));
+			Object_weak_unref(counter);
+		}
+		assert(counterFrees == frees + 200);
+	}
+
+	{
+		// A release racing weak locks frees the object exactly once, even if a lock revives it and releases it again
+		uint64_t alive = Object_alive_get();
+		int frees = counterFrees;
+		const int rounds = 20000;
+		std::atomic<Object*> current{NULL};
+		std::atomic<int> published{0};
+		std::atomic<int> finished{0};
+		std::thread locker([&] {
+			for (int round = 1; round <= rounds; round++) {
+				while (published < round)
+					std::this_thread::yield();
+				Object* counter = current;
+				while (Object_weak_lock(counter))
+					Object_unref(counter);
+				finished = round;
+			}
+		});
+		for (int round = 1; round <= rounds; round++) {
+			Object* counter = Counter_create();
+			Object_weak_ref(counter);
+			current = counter;
+			published = round;
+			Object_unref(counter);
+			while (finished < round)
+				std::this_thread::yield();
+			Object_weak_unref(counter);
+		}
+		locker.join();
+		assert(Object_alive_get() == alive);
+		assert(counterFrees == frees + rounds);
+	}
+
+
+
+	// Atomic reference example
+	printf("\nAtomic reference example\n");
+
+	{
+		int frees = counterFrees;
+		AtomicRef current{Ref(Counter_create())};
+		std::atomic<bool> stopping{false};
+		std::vector<std::thread> readers;
+		for (int t = 0; t < 3; t++) {
+			readers.emplace_back([&] {
+				while (!stopping) {
+					// Each load takes a reference from the stored object's batch
+					Ref counter = current.load();
+					assert(counter && Object_slots_get(counter, &Counter_class));
+				}
+			});
+		}
+		for (int i = 0; i < 1000; i++)
+			current.store(Ref(Counter_create()));
+		// Enough loads to replenish the batch several times
+		for (int i = 0; i < 100000; i++)
+			Ref counter = current.load();
+		stopping = true;
+		for (std::thread& reader : readers)
+			reader.join();
+		Object_thread_refs_merge();
+		assert(counterFrees == frees + 1000);
+
+		Ref expected = current.load();
+		Ref desired(Counter_create());
+		assert(current.compare_exchange(expected, desired));
+		assert(!current.compare_exchange(expected, Ref(Counter_create())));
+		assert(expected == desired);
+		current.store(Ref());
+		assert(!current.load());
+		expected = Ref();
+		Object_thread_refs_merge();
+		assert(counterFrees == frees + 1002);
+		assert(Object_refs_get(desired) == 1);
+
+		// Batches shrink as an object's count grows, so many atomic references to it don't overflow the count
+		std::vector<AtomicRef> many(100000);
+		for (AtomicRef& ref : many)
+			ref.store(desired);
+		assert(Object_refs_get(desired) > 100000 && Object_refs_get(desired) < UINT32_C(1) << 31);
+		many.clear();
+		Object_thread_refs_merge();
+		assert(Object_refs_get(desired) == 1);
+	}
+
+
+
+	// RCU example
+	printf("\nRCU example\n");
+
+	{
+		int frees = counterFrees;
+		RcuRef current{Ref(Counter_create())};
+		std::atomic<bool> stopping{false};
+		std::vector<std::thread> readers;
+		for (int t = 0; t < 3; t++) {
+			readers.emplace_back([&] {
+				while (!stopping) {
+					// Readers don't change the reference count, and the object stays alive until they leave
+					RcuReadLock lock;
+					Object* counter = current.get();
+					assert(counter && Object_slots_get(counter, &Counter_class));
+					Object* borrowed = test_preset_get();
+					assert(!borrowed || Object_slots_get(borrowed, &Counter_class));
+				}
+			});
+		}
+		for (int i = 0; i < 1000; i++) {
+			current.publish(Ref(Counter_create()));
+			Ref counter(Counter_create());
+			test_preset_set(counter);
+		}
+		stopping = true;
+		for (std::thread& reader : readers)
+			reader.join();
+		test_preset_set(NULL);
+		// Replaced objects are released once no reader can see them
+		Object_rcu_synchronize();
+		assert(counterFrees == frees + 2000);
+		Ref shared(current.share());
+		assert(Object_refs_get(shared) == 2);
+	}
+
+
+
+	// Region example
+	printf("\nRegion example\n");
+
+	{
+		int frees = counterFrees;
+		ObjectRegion* region = Object_region_create();
+		// _create() functions allocate in the thread's region
+		Object_thread_region_set(region);
+		for (int i = 0; i < 100; i++) {
+			Object* counter = Counter_create();
+			assert(Object_region_get(counter) == region);
+		}
+		Object_thread_region_set(NULL);
+		Object* outside = Counter_create();
+		assert(Object_region_get(outside) == NULL);
+		Object_unref(outside);
+		char* bytes = (char*) Object_region_alloc(region, 100);
+		memset(bytes, 1, 100);
+		// The region's objects are freed together
+		Object_region_destroy(region);
+		assert(counterFrees == frees + 101);
+	}
+
+
+
+	// Caller storage example
+	printf("\nCaller storage example\n");
+
+	{
+		alignas(64) unsigned char storage[256];
+		assert(Object_size_get() <= sizeof(storage) && Object_align_get() <= 64);
+		assert(Object_init_in(storage + 1) == NULL);
+		int frees = counterFrees;
+		Object* counter = Object_init_in(storage);
+		assert((void*) counter == storage);
+		Counter_specialize(counter);
+		assert(Object_slots_get(counter, &Counter_class));
+		// Other references are counted as usual, but must be released before Object_deinit()
+		Object_ref(counter);
+		Object_unref(counter);
+		Object_deinit(counter);
+		assert(counterFrees == frees + 1);
+	}
+
+
+
+	// Recycling example
+	printf("\nRecycling example\n");
+
+	{
+		int frees = counterFrees;
+		uint64_t reused = Object_recycled_count_get();
+		Object_recycle_capacity_set(4);
+		Object* counter = Counter_create();
+		((Counter*) Object_slots_get(counter, &Counter_class))->n = 5;
+		Object_unref(counter);
+		// The released object is reset and kept instead of freed
+		assert(counterFrees == frees);
+		Object* again = Counter_create();
+		assert(again == counter && Object_recycled_count_get() == reused + 1);
+		assert(((Counter*) Object_slots_get(again, &Counter_class))->n == 0);
+		Object_unref(again);
+
+		// Objects created in a region aren't taken from the pool
+		ObjectRegion* region = Object_region_create();
+		Object_thread_region_set(region);
+		Object* inRegion = Counter_create();
+		Object_thread_region_set(NULL);
+		assert(inRegion != counter && Object_region_get(inRegion) == region);
+		Object_region_destroy(region);
+		assert(counterFrees == frees + 1);
+
+		// Lowering the capacity frees the kept objects
+		Object_recycle_capacity_set(0);
+		assert(counterFrees == frees + 2);
+	}
+
+	{
+		// Threads keep and take objects from the same pool concurrently
+		uint64_t alive = Object_alive_get();
+		Object_recycle_capacity_set(16);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; t++) {
+			threads.emplace_back([] {
+				for (int round = 0; round < 1000; round++) {
+					Object* counters[4];
+					for (Object*& counter : counters) {
+						counter = Counter_create();
+						Counter* slot = (Counter*) Object_slots_get(counter, &Counter_class);
+						assert(slot->n == 0);
+						slot->n = round;
+					}
+					for (Object* counter : counters)
+						Object_unref(counter);
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+		Object_recycle_capacity_set(0);
+		assert(Object_alive_get() == alive);
+	}
+
+
+
+	// Runtime-allocated slot example
+	printf("\nRuntime-allocated slot example\n");
+
+	{
+		// Animal's slot is allocated by the runtime from a pool for its size, and counted per class
+		uint64_t slots = Object_class_slots_count_get(&Animal_class);
+		Object* animal = Animal_create();
+		assert(Object_class_slots_count_get(&Animal_class) == slots + 1);
+		assert(Object_class_slots_bytes_get(&Animal_class) == (slots + 1) * Animal_class.slotSize);
+		// A class can't be pushed twice
+		assert(!Object_classes_push_alloc(animal, &Animal_class));
+		void* slot = Object_slots_get(animal, &Animal_class);
+		Animal_legs_set(animal, 4);
+		Object_unref(animal);
+		assert(Object_class_slots_count_get(&Animal_class) == slots);
+		// Freed slots are reused, zeroed
+		animal = Animal_create();
+		assert(Object_slots_get(animal, &Animal_class) == slot && *(int*) slot == 0);
+		Object_unref(animal);
+
+		// Classes whose slots the runtime frees can't be pushed with caller-owned slots
+		static int callerSlot;
+		Object* object = Object_create();
+		Object_classes_push(object, &Animal_class, &callerSlot);
+		assert(!Object_slots_get(object, &Animal_class));
+		Object_unref(object);
+	}
+
 	return 0;
 }
\ No newline at end of file
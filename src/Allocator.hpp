@@ -0,0 +1,305 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+
+#include <Object/Object.h>
+
+
+static void* ObjectAllocator_defaultAlloc(void* context, size_t size, size_t align) {
+	(void) context;
+	return ::operator new(size, std::align_val_t(align), std::nothrow);
+}
+
+
+static void ObjectAllocator_defaultFree(void* context, void* block, size_t size, size_t align) {
+	(void) context;
+	(void) size;
+	::operator delete(block, std::align_val_t(align));
+}
+
+
+/** Allocator of an allocation category, on its own cache line so replacing one category's allocator doesn't slow down another. */
+struct alignas(64) ObjectAllocCategoryState {
+	ObjectAllocator allocator = {ObjectAllocator_defaultAlloc, ObjectAllocator_defaultFree, NULL};
+};
+
+/** Constant-initialized, so allocations made during static initialization use the default allocator. */
+static ObjectAllocCategoryState objectAllocCategories[OBJECT_ALLOC_CATEGORIES];
+
+
+/** Allocation counters of a thread, written only by that thread so counting needs no atomic read-modify-write.
+Readers sum the counters of every thread.
+*/
+struct ObjectAllocCounters {
+	/** Number of allocations made. */
+	std::atomic<uint64_t> counts[OBJECT_ALLOC_CATEGORIES];
+	/** Bytes allocated minus bytes freed, negative if the thread freed blocks that other threads allocated. */
+	std::atomic<int64_t> bytes[OBJECT_ALLOC_CATEGORIES];
+	/** Whether several threads write the counters, so they must be updated with read-modify-writes. */
+	bool shared;
+	ObjectAllocCounters* next;
+};
+
+/** Counters of all running threads. */
+struct ObjectAllocCountersList {
+	std::mutex mutex;
+	ObjectAllocCounters* head = NULL;
+	/** Counters of exited threads, also written by threads that allocate after their counters are gone. */
+	ObjectAllocCounters retired = {{}, {}, true, NULL};
+};
+
+static ObjectAllocCountersList objectAllocCounters;
+static thread_local ObjectAllocCounters* threadAllocCounters = NULL;
+
+
+/** Links the calling thread's counters into the list, and retires them when the thread exits. */
+struct ObjectAllocCountersThread {
+	ObjectAllocCounters counters = {{}, {}, false, NULL};
+
+	ObjectAllocCountersThread() {
+		std::lock_guard<std::mutex> lock(objectAllocCounters.mutex);
+		counters.next = objectAllocCounters.head;
+		objectAllocCounters.head = &counters;
+		threadAllocCounters = &counters;
+	}
+
+	~ObjectAllocCountersThread() {
+		std::lock_guard<std::mutex> lock(objectAllocCounters.mutex);
+		ObjectAllocCounters& retired = objectAllocCounters.retired;
+		for (uint32_t i = 0; i < OBJECT_ALLOC_CATEGORIES; i++) {
+			retired.counts[i].fetch_add(counters.counts[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+			retired.bytes[i].fetch_add(counters.bytes[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+		ObjectAllocCounters** link = &objectAllocCounters.head;
+		while (*link != &counters)
+			link = &(*link)->next;
+		*link = counters.next;
+		// Later allocations on this thread, such as by other thread_local destructors, are counted as retired
+		threadAllocCounters = &retired;
+	}
+};
+
+
+__attribute__((noinline, cold))
+static ObjectAllocCounters* ObjectAllocCounters_create() {
+	static thread_local ObjectAllocCountersThread thread;
+	(void) thread;
+	return threadAllocCounters;
+}
+
+
+template <typename T>
+static inline void ObjectAllocCounters_add(const ObjectAllocCounters* counters, std::atomic<T>& counter, T n) {
+	if (__builtin_expect(counters->shared, 0))
+		counter.fetch_add(n, std::memory_order_relaxed);
+	else
+		counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+
+static inline void ObjectAllocCounters_count(ObjectAllocCategory category, int64_t bytes, bool alloc) {
+	ObjectAllocCounters* counters = threadAllocCounters;
+	if (__builtin_expect(!counters, 0))
+		counters = ObjectAllocCounters_create();
+	if (alloc)
+		ObjectAllocCounters_add<uint64_t>(counters, counters->counts[category], 1);
+	ObjectAllocCounters_add<int64_t>(counters, counters->bytes[category], bytes);
+}
+
+
+/** Returns the number of allocations made in a category by all threads. */
+static uint64_t ObjectAllocator_count_get(ObjectAllocCategory category) {
+	std::lock_guard<std::mutex> lock(objectAllocCounters.mutex);
+	uint64_t count = objectAllocCounters.retired.counts[category].load(std::memory_order_relaxed);
+	for (ObjectAllocCounters* counters = objectAllocCounters.head; counters; counters = counters->next)
+		count += counters->counts[category].load(std::memory_order_relaxed);
+	return count;
+}
+
+
+/** Returns the bytes currently allocated in a category, summed over all threads. */
+static uint64_t ObjectAllocator_bytes_get(ObjectAllocCategory category) {
+	std::lock_guard<std::mutex> lock(objectAllocCounters.mutex);
+	int64_t bytes = objectAllocCounters.retired.bytes[category].load(std::memory_order_relaxed);
+	for (ObjectAllocCounters* counters = objectAllocCounters.head; counters; counters = counters->next)
+		bytes += counters->bytes[category].load(std::memory_order_relaxed);
+	return uint64_t(bytes);
+}
+
+
+/** Allocates a block from a category's allocator.
+Aborts if the allocator fails, since the runtime has no way to report it.
+*/
+static void* ObjectAllocator_alloc(ObjectAllocCategory category, size_t size, size_t align) {
+	ObjectAllocCategoryState& state = objectAllocCategories[category];
+	void* block = state.allocator.alloc(state.allocator.context, size, align);
+	if (!block) {
+		fprintf(stderr, "Object: allocator failed to allocate %zu bytes\n", size);
+		abort();
+	}
+	ObjectAllocCounters_count(category, int64_t(size), true);
+	return block;
+}
+
+
+/** Frees a block allocated by ObjectAllocator_alloc() with the same category, size, and alignment. */
+static void ObjectAllocator_free(ObjectAllocCategory category, void* block, size_t size, size_t align) {
+	if (!block)
+		return;
+	ObjectAllocCategoryState& state = objectAllocCategories[category];
+	ObjectAllocCounters_count(category, -int64_t(size), false);
+	state.allocator.free(state.allocator.context, block, size, align);
+}
+
+
+template <typename T, typename... Args>
+static T* ObjectAllocator_new(ObjectAllocCategory category, Args&&... args) {
+	return new (ObjectAllocator_alloc(category, sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+}
+
+
+template <typename T>
+static void ObjectAllocator_delete(ObjectAllocCategory category, const T* p) {
+	if (!p)
+		return;
+	p->~T();
+	ObjectAllocator_free(category, (void*) p, sizeof(T), alignof(T));
+}
+
+
+/** Allocates an array of value-initialized elements, or returns NULL if length is 0. */
+template <typename T>
+static T* ObjectAllocator_newArray(ObjectAllocCategory category, size_t length) {
+	if (length == 0)
+		return NULL;
+	T* p = (T*) ObjectAllocator_alloc(category, length * sizeof(T), alignof(T));
+	for (size_t i = 0; i < length; i++)
+		new (&p[i]) T();
+	return p;
+}
+
+
+/** Frees an array allocated by ObjectAllocator_newArray() with the same length. */
+template <typename T>
+static void ObjectAllocator_deleteArray(ObjectAllocCategory category, T* p, size_t length) {
+	if (!p)
+		return;
+	for (size_t i = 0; i < length; i++)
+		p[i].~T();
+	ObjectAllocator_free(category, (void*) p, length * sizeof(T), alignof(T));
+}
+
+
+/** Bump allocator for temporary arrays that are all released together by reset().
+Memory is kept between resets, and grown to the largest total seen, so steady-state use doesn't allocate.
+Not thread-safe, so each thread uses its own.
+*/
+struct ScratchArena {
+	/** Allocation that didn't fit in the block, freed at the next reset(). */
+	struct Overflow {
+		Overflow* next;
+		size_t size;
+		size_t align;
+	};
+
+	ObjectAllocCategory category;
+	char* block = NULL;
+	size_t capacity = 0;
+	size_t used = 0;
+	/** Bytes requested since the last reset(), including alignment padding. */
+	size_t requested = 0;
+	Overflow* overflows = NULL;
+
+	explicit ScratchArena(ObjectAllocCategory category) : category(category) {}
+
+	~ScratchArena() {
+		requested = 0;
+		reset();
+		ObjectAllocator_free(category, block, capacity, alignof(std::max_align_t));
+	}
+
+	ScratchArena(const ScratchArena&) = delete;
+	ScratchArena& operator=(const ScratchArena&) = delete;
+
+	/** Returns uninitialized memory valid until the next reset(). align must be a power of 2. */
+	void* alloc(size_t size, size_t align) {
+		requested += size + align;
+		uintptr_t p = (uintptr_t(block) + used + align - 1) & ~uintptr_t(align - 1);
+		if (block && p + size <= uintptr_t(block) + capacity) {
+			used = p + size - uintptr_t(block);
+			return (void*) p;
+		}
+		// Place a header before the data, padded to keep the data aligned
+		align = std::max(align, alignof(Overflow));
+		size_t header = (sizeof(Overflow) + align - 1) & ~(align - 1);
+		char* o = (char*) ObjectAllocator_alloc(category, header + size, align);
+		Overflow* overflow = (Overflow*) o;
+		overflow->next = overflows;
+		overflow->size = header + size;
+		overflow->align = align;
+		overflows = overflow;
+		return o + header;
+	}
+
+	/** Releases every allocation, and grows the block if the allocations since the last reset() didn't fit. */
+	void reset() {
+		while (Overflow* overflow = overflows) {
+			overflows = overflow->next;
+			ObjectAllocator_free(category, overflow, overflow->size, overflow->align);
+		}
+		if (requested > capacity) {
+			ObjectAllocator_free(category, block, capacity, alignof(std::max_align_t));
+			capacity = std::max(requested, 2 * capacity);
+			block = (char*) ObjectAllocator_alloc(category, capacity, alignof(std::max_align_t));
+		}
+		used = 0;
+		requested = 0;
+	}
+};
+
+
+/** Standard allocator that takes memory from a category's allocator, for containers the runtime keeps. */
+template <typename T, ObjectAllocCategory category>
+struct ObjectStdAllocator {
+	typedef T value_type;
+	template <typename U>
+	struct rebind {
+		typedef ObjectStdAllocator<U, category> other;
+	};
+
+	ObjectStdAllocator() = default;
+	template <typename U>
+	ObjectStdAllocator(const ObjectStdAllocator<U, category>&) {}
+
+	T* allocate(size_t n) {
+		return (T*) ObjectAllocator_alloc(category, n * sizeof(T), alignof(T));
+	}
+
+	void deallocate(T* p, size_t n) {
+		ObjectAllocator_free(category, p, n * sizeof(T), alignof(T));
+	}
+
+	template <typename U>
+	bool operator==(const ObjectStdAllocator<U, category>&) const { return true; }
+	template <typename U>
+	bool operator!=(const ObjectStdAllocator<U, category>&) const { return false; }
+};
+
+template <typename T>
+using SchemaVector = std::vector<T, ObjectStdAllocator<T, OBJECT_ALLOC_SCHEMAS>>;
+
+template <typename T>
+using RuntimeVector = std::vector<T, ObjectStdAllocator<T, OBJECT_ALLOC_RUNTIME>>;
+
+template <typename K, typename V>
+using RuntimeMap = std::unordered_map<K, V, std::hash<K>, std::equal_to<K>, ObjectStdAllocator<std::pair<const K, V>, OBJECT_ALLOC_RUNTIME>>;
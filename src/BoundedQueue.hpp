@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <atomic>
+
+
+/** Lock-free bounded multi-producer multi-consumer queue.
+push() and pop() never allocate or block, and fail if the queue is full or empty.
+This follows Dmitry Vyukov's bounded MPMC queue (https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue).
+*/
+template <typename T, uint32_t N>
+struct BoundedQueue {
+	static_assert((N & (N - 1)) == 0, "BoundedQueue capacity must be a power of two");
+
+	struct Cell {
+		/** Equal to the position that may push into this cell next, or that position plus 1 once pushed. */
+		std::atomic<uint64_t> sequence;
+		T value;
+	};
+
+	Cell cells[N];
+	alignas(64) std::atomic<uint64_t> pushPosition{0};
+	alignas(64) std::atomic<uint64_t> popPosition{0};
+
+	BoundedQueue() {
+		for (uint32_t i = 0; i < N; i++)
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	BoundedQueue(const BoundedQueue&) = delete;
+	BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+	/** Returns false if the queue is full. */
+	bool push(const T& value) {
+		uint64_t position = pushPosition.load(std::memory_order_relaxed);
+		while (true) {
+			Cell& cell = cells[position & (N - 1)];
+			uint64_t sequence = cell.sequence.load(std::memory_order_acquire);
+			int64_t diff = int64_t(sequence - position);
+			if (diff == 0) {
+				if (pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					cell.value = value;
+					cell.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			// The cell still holds the value pushed N positions ago
+			else if (diff < 0) {
+				return false;
+			}
+			else {
+				position = pushPosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/** Returns false if the queue is empty. */
+	bool pop(T& value) {
+		uint64_t position = popPosition.load(std::memory_order_relaxed);
+		while (true) {
+			Cell& cell = cells[position & (N - 1)];
+			uint64_t sequence = cell.sequence.load(std::memory_order_acquire);
+			int64_t diff = int64_t(sequence - (position + 1));
+			if (diff == 0) {
+				if (popPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					value = cell.value;
+					cell.sequence.store(position + N, std::memory_order_release);
+					return true;
+				}
+			}
+			// The cell hasn't been pushed yet
+			else if (diff < 0) {
+				return false;
+			}
+			else {
+				position = popPosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/** Returns the number of values in the queue, which may be stale under concurrent use. */
+	uint64_t size_get() const {
+		uint64_t pushed = pushPosition.load(std::memory_order_relaxed);
+		uint64_t popped = popPosition.load(std::memory_order_relaxed);
+		return pushed > popped ? pushed - popped : 0;
+	}
+};
@@ -6,315 +6,2726 @@ Feel free to rewrite this in other languages that can export C symbols.
 
 #include <cstdlib>
 #include <cstdint>
+#include <cstddef>
 #include <cstdio>
-#include <vector>
+#include <cstring>
 #include <atomic>
+#include <new>
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <Object/Object.h>
+#include "Allocator.hpp"
 #include "Schema.hpp"
+#include "BoundedQueue.hpp"
 
 
 #define LENGTHOF(arr) (sizeof(arr) / sizeof((arr)[0]))
 
 
-/** Size of Class is part of the ABI. */
-static_assert(sizeof(Class) == 256, "Object Class size must be 256 bytes");
+/** Size of Class is part of the ABI. Fields take the place of reserved pointers, so it is 256 bytes on 64-bit targets and 128 bytes on 32-bit targets. */
+static_assert(sizeof(Class) == 32 * sizeof(void*), "Object Class size must be 32 pointers");
 
 
 static std::atomic<uint64_t> alive{0};
 
 
 static SchemaNode* rootNode_get() {
-	static SchemaNode* const rootNode = new SchemaNode;
+	static SchemaNode* const rootNode = SchemaNode_alloc();
 	return rootNode;
 }
 
 
+#if defined OBJECT_BIASED_REFS
+struct ObjectOwner;
+static ObjectOwner* ObjectOwner_thread_get();
+struct Object;
+static void Object_refs_bias(Object* self);
+#endif
+
+
 struct alignas(64) Object {
 	const SchemaNode* schemaNode = rootNode_get();
 	std::atomic<const Schema*> schema{NULL};
+#if !defined OBJECT_REFS_SEPARATE
 	/** Packed reference counts.
-	Low 32 bits = strong refs, high 32 bits = weak refs.
+	Low 31 bits = strong refs, bit 31 = DEAD, bits 32-58 = weak refs, bit 59 = EXTERNAL, bit 60 = REGION, bit 61 = HANDLE, bit 62 = WEAK_BLOCK, bit 63 = IMMORTAL.
+	With OBJECT_BIASED_REFS, strong refs are counted by biasedRefs and sharedRefs instead, and the low 31 bits are 1 until they reach zero.
 	*/
 	std::atomic<uint64_t> refs{1};
+#endif
 	void* slotsInline[4] = {};
 	void** slotsSpill = NULL;
+#if defined OBJECT_REFS_SEPARATE
+	/** Packed reference counts, as above.
+	Placed on their own cache line, so reference counting on one thread doesn't invalidate the line that method calls and slot lookups read on other threads.
+	*/
+	alignas(64) std::atomic<uint64_t> refs{1};
+#endif
+
+	/** Set by Object_immortalize(), after which reference counts are frozen. */
+	static const uint64_t refsImmortal = uint64_t(1) << 63;
+	/** Set once strong refs reach zero for good, after which Object_weak_lock() fails.
+	Object_weak_lock() may briefly increment the strong refs of a dead object before undoing it.
+	*/
+	static const uint64_t refsDead = uint64_t(1) << 31;
+	static const uint64_t refsStrongMask = refsDead - 1;
+	/** Set once ObjectWeak_get() creates the object's ObjectWeak block. */
+	static const uint64_t refsWeakBlock = uint64_t(1) << 62;
+	/** Set once Object_handle_get() allocates the object's handle table entry. */
+	static const uint64_t refsHandle = uint64_t(1) << 61;
+	/** Set if the object was created by Object_create_in(), in which case Object_region_destroy() releases its shell and slot spill array. */
+	static const uint64_t refsRegion = uint64_t(1) << 60;
+	/** Set if the object was created by Object_init_in() in storage owned by the caller, so its shell is never deleted. */
+	static const uint64_t refsExternal = uint64_t(1) << 59;
+	static const uint64_t refsWeakMask = 0x7FFFFFF;
+#if defined OBJECT_BIASED_REFS
+	/** Thread whose strong refs are counted in biasedRefs without atomic read-modify-writes, or NULL once the counts are merged. */
+	std::atomic<const ObjectOwner*> owner{ObjectOwner_thread_get()};
+	/** Strong refs held by the owner thread.
+	Only written by the owner, but atomic so other threads may read it.
+	*/
+	std::atomic<uint32_t> biasedRefs{1};
+	/** Low 32 bits = strong refs held by other threads plus `sharedZero`, so it can go negative before merging.
+	Bit 32 = MERGED, set once biasedRefs is folded in. Bit 33 = QUEUED, set once the object is queued for its owner to merge.
+	*/
+	std::atomic<uint64_t> sharedRefs{sharedZero};
+	/** Next object in the owner's merge queue. */
+	Object* mergeNext = NULL;
+
+	static const uint64_t sharedZero = uint64_t(1) << 31;
+	static const uint64_t sharedMerged = uint64_t(1) << 32;
+	static const uint64_t sharedQueued = uint64_t(1) << 33;
+#endif
 };
 
 
-static const Schema* Object_schema_get(const Object* self) {
+/** Allocates a slot spill array outside a region.
+Its length is stored in the word before the first slot, so it can be freed with its size.
+*/
+static void** Object_slotsSpill_alloc(uint32_t length) {
+	void** block = (void**) ObjectAllocator_alloc(OBJECT_ALLOC_SLOTS, (length + 1) * sizeof(void*), alignof(void*));
+	block[0] = (void*) uintptr_t(length);
+	return block + 1;
+}
+
+
+static void Object_slotsSpill_free(void** spill) {
+	if (!spill)
+		return;
+	uint32_t length = uint32_t(uintptr_t(spill[-1]));
+	ObjectAllocator_free(OBJECT_ALLOC_SLOTS, spill - 1, (length + 1) * sizeof(void*), alignof(void*));
+}
+
+
+/** Whether the calling thread was marked real-time with Object_thread_realtime_set(). */
+static thread_local bool threadRealtime = false;
+static std::atomic<uint64_t> realtimeBuilds{0};
+static std::atomic<bool> realtimeBuildsAbort{false};
+
+
+/** Builds a node's schema on the calling thread, and reports the build if the thread is marked real-time. */
+__attribute__((noinline, cold))
+static const Schema* Object_schemaNode_build(const SchemaNode* node) {
+	if (threadRealtime) {
+		realtimeBuilds.fetch_add(1, std::memory_order_relaxed);
+		if (realtimeBuildsAbort.load(std::memory_order_relaxed)) {
+			fprintf(stderr, "Object: schema built lazily on a real-time thread. Call Object_schema_prepare() before handing objects to real-time threads.\n");
+			abort();
+		}
+	}
+	return SchemaNode_schema_build(node);
+}
+
+
+/** Claims and builds the schema of the object's node, or hands it to the background builder in async mode.
+Returns NULL if the schema is being built by another thread.
+*/
+__attribute__((noinline, cold))
+static const Schema* Object_schema_claim(const Object* self) {
+	const SchemaNode* node = self->schemaNode;
+	const Schema* schema = node->schema.load(std::memory_order_acquire);
+	if (!schema) {
+		if (!SchemaNode_build_claim(node))
+			return NULL;
+		if (SchemaBuilder_enqueue(node))
+			return NULL;
+		schema = Object_schemaNode_build(node);
+	}
+	const_cast<Object*>(self)->schema.store(schema, std::memory_order_release);
+	return schema;
+}
+
+
+/** Returns the object's schema, or NULL if another thread is building it.
+Callers answer lookups from the push history when this returns NULL.
+*/
+static inline const Schema* Object_schema_get(const Object* self) {
+	const Schema* schema = self->schema.load(std::memory_order_acquire);
+	if (schema)
+		return schema;
+	return Object_schema_claim(self);
+}
+
+
+/** Returns the object's schema, building it on the calling thread even if another thread is building it.
+*/
+static const Schema* Object_schema_require(const Object* self) {
 	const Schema* schema = self->schema.load(std::memory_order_acquire);
 	if (schema)
 		return schema;
-	schema = SchemaNode_schema_get(self->schemaNode);
+	schema = self->schemaNode->schema.load(std::memory_order_acquire);
+	if (!schema)
+		schema = Object_schemaNode_build(self->schemaNode);
 	const_cast<Object*>(self)->schema.store(schema, std::memory_order_release);
 	return schema;
 }
 
 
-Object* Object_create() {
-	Object* self = new Object;
-	// assert(self);
-	alive.fetch_add(1, std::memory_order_relaxed);
-	return self;
+/** Moves the object to a node that the caller has acquired, and releases its previous node. */
+static void Object_schemaNode_set(Object* self, const SchemaNode* node) {
+	const SchemaNode* oldNode = self->schemaNode;
+	self->schemaNode = node;
+	self->schema.store(node->schema.load(std::memory_order_acquire), std::memory_order_relaxed);
+	SchemaNode_release(oldNode);
 }
 
 
-void Object_ref(const Object* self) {
-	if (!self)
-		return;
-	// This check isn't part of the thread-safety guarantee, but it protects against obtaining a reference within a free() function.
-	uint64_t refs = self->refs.load();
-	if ((refs & 0xFFFFFFFF) == 0)
-		return;
-	// Increment strong reference count
-	const_cast<Object*>(self)->refs.fetch_add(1);
+/** Returns a built schema with the object's classes, without building one.
+Class push nodes always have a built schema, so the nearest built ancestor lies at or below the object's last class push, and has the same classes.
+Returns NULL if the object has no classes and no built ancestor.
+*/
+static const Schema* Object_classesSchema_get(const Object* self) {
+	const Schema* schema = self->schema.load(std::memory_order_acquire);
+	for (const SchemaNode* n = self->schemaNode; !schema && n; n = n->parent)
+		schema = n->schema.load(std::memory_order_acquire);
+	return schema;
 }
 
 
-void Object_unref(const Object* self) {
-	if (!self)
-		return;
-	// This check isn't part of the thread-safety guarantee, but it protects against releasing a reference within a free() function.
-	uint64_t refs = self->refs.load();
-	if ((refs & 0xFFFFFFFF) == 0)
-		return;
-	// Decrement strong reference count
-	refs = const_cast<Object*>(self)->refs.fetch_sub(1);
-	if ((refs & 0xFFFFFFFF) != 1)
-		return;
-	// Prevent the Object from being deleted during free callbacks by adding a weak reference.
-	Object_weak_ref(self);
-	// Remove all classes from top to bottom
-	const Class* clsBottom = NULL;
-	for (const SchemaNode* n = self->schemaNode; n; n = n->parent) {
-		if (n->delta.type == SchemaDelta::CLASS)
-			clsBottom = n->delta.cls;
+struct ObjectWeak {
+	/** The object, or NULL once its strong refs reach zero. */
+	std::atomic<const Object*> object;
+	/** Weak refs held by callers, plus one held by the object until its strong refs reach zero. */
+	std::atomic<uint32_t> refs;
+};
+
+
+/** Runtime records attached to an object outside its shell. */
+struct ObjectSide {
+	ObjectWeak* weak = NULL;
+	/** Index of the object's HandleEntry, or 0 if none. */
+	uint32_t handleIndex = 0;
+};
+
+
+/** Maps objects to their ObjectSide records.
+Split into stripes by object address, each with its own lock.
+*/
+struct SideTable {
+	struct alignas(64) Stripe {
+		/** Held while linking or unlinking a record, and while locking a weak block's object, so the object can't be freed meanwhile. */
+		std::mutex mutex;
+		RuntimeMap<const Object*, ObjectSide> sides;
+	};
+	Stripe stripes[64];
+
+	Stripe& stripe_get(const Object* self) {
+		return stripes[(uintptr_t(self) >> 6) % LENGTHOF(stripes)];
 	}
-	if (clsBottom)
-		Object_classes_remove(const_cast<Object*>(self), clsBottom);
-	// Release the prevent-deletion weak reference, allowing the Object to be deleted if no other weak references remain.
-	Object_weak_unref(self);
-}
+};
 
+static SideTable sideTable;
 
-uint32_t Object_refs_get(const Object* self) {
-	if (!self)
-		return 0;
-	return self->refs.load() & 0xFFFFFFFF;
-}
 
+/** An entry of the global handle table, referring to one object until its strong refs reach zero. */
+struct HandleEntry {
+	/** High 32 bits = generation, bit 31 = DEAD, low 31 bits = number of Object_handle_lock() calls reading `object`.
+	The generation is bumped when the entry is freed, so stale handles no longer match.
+	*/
+	std::atomic<uint64_t> word{dead};
+	/** Holds a weak ref, released once the entry is dead and unpinned. */
+	const Object* object = NULL;
+	/** Next index in the free list, plus 1. */
+	std::atomic<uint32_t> nextFree{0};
+
+	static const uint64_t dead = uint64_t(1) << 31;
+	static const uint64_t pinsMask = dead - 1;
+};
 
-void Object_weak_ref(const Object* self) {
-	if (!self)
-		return;
-	const_cast<Object*>(self)->refs.fetch_add(uint64_t(1) << 32);
+
+/** Handles are allocated from chunks that are never freed, so entries can be read without locks. */
+struct HandleTable {
+	static const uint32_t chunkSize = 1 << 12;
+	std::atomic<HandleEntry*> chunks[1 << 10] = {};
+	/** Number of indices handed out from fresh chunk space. Index 0 is never used, so handle 0 is null. */
+	std::atomic<uint32_t> used{1};
+	/** High 32 bits = ABA tag, low 32 bits = first free index plus 1. */
+	std::atomic<uint64_t> freeHead{0};
+};
+
+static HandleTable handleTable;
+
+
+/** Returns the entry at an index that has been allocated. */
+static HandleEntry* HandleTable_entry_get(uint32_t index) {
+	return &handleTable.chunks[index / HandleTable::chunkSize].load(std::memory_order_acquire)[index % HandleTable::chunkSize];
 }
 
 
-void Object_weak_unref(const Object* self) {
-	if (!self)
-		return;
-	uint64_t refs = self->refs.load();
-	if ((refs >> 32) == 0)
-		return;
-	// Decrement weak reference count
-	refs = const_cast<Object*>(self)->refs.fetch_sub(uint64_t(1) << 32);
-	uint32_t refs_strong = refs & 0xFFFFFFFF;
-	uint32_t refs_weak = refs >> 32;
-	// Free Object shell if this was the last weak ref and strong refs are already gone
-	if (refs_weak == 1 && refs_strong == 0) {
-		alive.fetch_sub(1, std::memory_order_relaxed);
-		free(self->slotsSpill);
-		delete self;
+/** Returns a free entry index, or 0 if the table is full. */
+static uint32_t HandleTable_alloc() {
+	uint64_t head = handleTable.freeHead.load(std::memory_order_acquire);
+	while ((uint32_t) head) {
+		uint32_t index = (uint32_t) head - 1;
+		uint32_t next = HandleTable_entry_get(index)->nextFree.load(std::memory_order_relaxed);
+		uint64_t newHead = ((head >> 32) + 1) << 32 | next;
+		if (handleTable.freeHead.compare_exchange_weak(head, newHead, std::memory_order_acquire))
+			return index;
+	}
+	uint32_t index = handleTable.used.fetch_add(1, std::memory_order_relaxed);
+	uint32_t chunkIndex = index / HandleTable::chunkSize;
+	if (chunkIndex >= LENGTHOF(handleTable.chunks)) {
+		handleTable.used.fetch_sub(1, std::memory_order_relaxed);
+		return 0;
 	}
+	if (!handleTable.chunks[chunkIndex].load(std::memory_order_acquire)) {
+		HandleEntry* chunk = ObjectAllocator_newArray<HandleEntry>(OBJECT_ALLOC_RUNTIME, HandleTable::chunkSize);
+		HandleEntry* expected = NULL;
+		if (!handleTable.chunks[chunkIndex].compare_exchange_strong(expected, chunk, std::memory_order_acq_rel))
+			ObjectAllocator_deleteArray(OBJECT_ALLOC_RUNTIME, chunk, HandleTable::chunkSize);
+	}
+	return index;
 }
 
 
-uint32_t Object_weak_refs_get(const Object* self) {
-	if (!self)
-		return 0;
-	return self->refs.load() >> 32;
+/** Releases a dead entry's weak ref and returns it to the free list. */
+static void HandleTable_free(uint32_t index) {
+	HandleEntry* entry = HandleTable_entry_get(index);
+	const Object* self = entry->object;
+	entry->object = NULL;
+	// Bump the generation, and keep the entry dead until reused
+	uint64_t word = entry->word.load(std::memory_order_relaxed);
+	uint32_t generation = (word >> 32) + 1;
+	if (generation == 0)
+		generation = 1;
+	entry->word.store(uint64_t(generation) << 32 | HandleEntry::dead, std::memory_order_release);
+	uint64_t head = handleTable.freeHead.load(std::memory_order_relaxed);
+	do {
+		entry->nextFree.store((uint32_t) head, std::memory_order_relaxed);
+	} while (!handleTable.freeHead.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | (index + 1), std::memory_order_release, std::memory_order_relaxed));
+	Object_weak_unref(self);
 }
 
 
-bool Object_weak_lock(const Object* self) {
-	if (!self)
-		return false;
-	// Atomically increment strong refs only if currently > 0
-	uint64_t refs = self->refs.load();
-	while ((refs & 0xFFFFFFFF) > 0) {
-		if (const_cast<Object*>(self)->refs.compare_exchange_weak(refs, refs + 1))
-			return true;
-	}
-	return false;
+/** Unpins an entry, freeing it if it died while pinned. */
+static void HandleTable_unpin(uint32_t index) {
+	uint64_t word = HandleTable_entry_get(index)->word.fetch_sub(1, std::memory_order_acq_rel);
+	if ((word & HandleEntry::dead) && (word & HandleEntry::pinsMask) == 1)
+		HandleTable_free(index);
 }
 
 
-void Object_classes_push(Object* self, const Class* cls, void* slot) {
-	if (!self || !cls || !slot)
-		return;
-	// Fail silently if class already existed
-	const Schema* schema = Object_schema_get(self);
-	if (schema->slotIndices.find(cls))
-		return;
-	uint32_t slotIndex = schema->slotIndices.size;
-	self->schemaNode = SchemaNode_child_findOrCreate(self->schemaNode, SchemaDelta_classPush(cls));
-	self->schema.store(self->schemaNode->schema.load(std::memory_order_acquire), std::memory_order_relaxed);
-	// Store slot inline, or grow the spill array to its exact derived size
-	if (slotIndex < LENGTHOF(self->slotsInline)) {
-		self->slotsInline[slotIndex] = slot;
+/** Unlinks the object's side records after its strong refs reach zero, so ObjectWeak_lock() and Object_handle_lock() fail. */
+static void Object_side_detach(const Object* self) {
+	ObjectSide side;
+	{
+		SideTable::Stripe& stripe = sideTable.stripe_get(self);
+		std::lock_guard<std::mutex> lock(stripe.mutex);
+		auto it = stripe.sides.find(self);
+		if (it == stripe.sides.end())
+			return;
+		side = it->second;
+		stripe.sides.erase(it);
+		if (side.weak)
+			side.weak->object.store(NULL, std::memory_order_relaxed);
 	}
-	else {
-		uint32_t spillIndex = slotIndex - LENGTHOF(self->slotsInline);
-		self->slotsSpill = (void**) realloc(self->slotsSpill, (spillIndex + 1) * sizeof(void*));
-		self->slotsSpill[spillIndex] = slot;
+	ObjectWeak_unref(side.weak);
+	if (side.handleIndex) {
+		// The last of this and any Object_handle_lock() calls in progress frees the entry
+		uint64_t word = HandleTable_entry_get(side.handleIndex)->word.fetch_or(HandleEntry::dead, std::memory_order_acq_rel);
+		if ((word & HandleEntry::pinsMask) == 0)
+			HandleTable_free(side.handleIndex);
 	}
 }
 
 
-// Don't allow inlining into callers when link-time optimization (LTO) is enabled because it overflows the instruction cache.
-__attribute__((noinline))
-void* Object_slots_get(const Object* self, const Class* cls) {
-	if (!self || !cls)
-		return NULL;
-	const Schema* schema = Object_schema_get(self);
-	const uint32_t* slotIndex = schema->slotIndices.find(cls);
-	if (!slotIndex)
-		return NULL;
-	if (*slotIndex < LENGTHOF(self->slotsInline))
-		return self->slotsInline[*slotIndex];
-	uint32_t spillIndex = *slotIndex - LENGTHOF(self->slotsInline);
-	return self->slotsSpill[spillIndex];
+/** Starts releasing an object whose strong refs reached zero, so that weak refs can neither lock nor delete it until Object_final_free(). */
+static void Object_final_begin(const Object* self) {
+	// Prevent the Object from being deleted during free callbacks by adding a weak reference.
+	Object_weak_ref(self);
+#if defined OBJECT_BIASED_REFS
+	// Replace the strong refs token with DEAD, checked by Object_weak_unref()
+	const_cast<Object*>(self)->refs.fetch_add(Object::refsDead - 1);
+#endif
+	if (self->refs.load(std::memory_order_relaxed) & (Object::refsWeakBlock | Object::refsHandle))
+		Object_side_detach(self);
 }
 
 
-void Object_classes_remove(Object* self, const Class* cls) {
-	if (!self)
-		return;
+/** Released objects kept for reuse by a class's _create() function, in an open-addressed table keyed by Class pointer so releasing and creating never lock.
+Kept objects are linked through their cached schema pointers, so keeping one never allocates.
+*/
+struct alignas(64) RecyclePool {
+	std::atomic<const Class*> cls{NULL};
+	/** Node of the objects returned by the class's _create() function, acquired so its address isn't reused, or NULL if unregistered. */
+	std::atomic<const SchemaNode*> node{NULL};
+	/** Most recently kept object.
+	Takers detach the whole list with an exchange and push the rest back, so a stale next link is never installed.
+	*/
+	std::atomic<Object*> head{NULL};
+	/** Number of kept objects, plus objects being reset before they're kept. */
+	std::atomic<uint32_t> count{0};
+};
 
-	// Fail silently if the object does not have the class
-	bool found = false;
-	for (const SchemaNode* n = self->schemaNode; n; n = n->parent) {
-		if (n->delta.type == SchemaDelta::CLASS && n->delta.cls == cls) {
-			found = true;
-			break;
-		}
-	}
-	if (!found)
-		return;
+static const uint32_t recyclePoolsShift = 8;
 
-	// Remove classes from top down to cls (inclusive)
-	for (const SchemaNode* n = self->schemaNode; n; n = n->parent) {
-		if (n->delta.type != SchemaDelta::CLASS)
-			continue;
-		const Class* c = n->delta.cls;
-		if (c->free)
-			c->free(self);
-		// Set parent class
-		self->schemaNode = n->parent;
-		self->schema.store(self->schemaNode->schema.load(std::memory_order_acquire), std::memory_order_relaxed);
-		// Stop at class cls
+/** Registering classes and changing the capacity, which are serialized by mutex. */
+struct RecyclePools {
+	std::mutex mutex;
+	std::atomic<uint32_t> capacity{0};
+	std::atomic<uint64_t> reused{0};
+	/** Classes beyond this many aren't recycled. */
+	RecyclePool pools[1 << recyclePoolsShift];
+};
+
+static RecyclePools recyclePools;
+
+
+static RecyclePool* RecyclePool_find(const Class* cls, bool insert) {
+	uint32_t index = uint32_t((uintptr_t(cls) * UINT64_C(0x9E3779B97F4A7C15)) >> (64 - recyclePoolsShift));
+	for (uint32_t i = 0; i < LENGTHOF(recyclePools.pools); i++) {
+		RecyclePool* pool = &recyclePools.pools[(index + i) & (LENGTHOF(recyclePools.pools) - 1)];
+		const Class* c = pool->cls.load(std::memory_order_acquire);
 		if (c == cls)
-			return;
+			return pool;
+		if (!c) {
+			if (!insert)
+				return NULL;
+			if (pool->cls.compare_exchange_strong(c, cls, std::memory_order_acq_rel) || c == cls)
+				return pool;
+		}
 	}
+	return NULL;
 }
 
 
-void Object_methods_push(Object* self, void* dispatcher, void* method) {
-	if (!self || !dispatcher || !method)
-		return;
-	// Find and return existing SchemaNode with the exact delta
-	SchemaDelta delta = SchemaDelta_methodPush(dispatcher, method);
-	SchemaNode* child = SchemaNode_child_find(self->schemaNode, delta);
-	if (child) {
-		self->schemaNode = child;
-		self->schema.store(child->schema.load(std::memory_order_acquire), std::memory_order_relaxed);
-		return;
-	}
-	// Check if the dispatcher already has a method
-	if (SchemaNode_method_find(self->schemaNode, dispatcher)) {
-		// Don't allow overriding with a method that was already pushed
-		if (SchemaNode_dispatcher_find(self->schemaNode, method))
-			return;
-	}
-	self->schemaNode = SchemaNode_child_findOrCreate(self->schemaNode, delta);
-	self->schema.store(self->schemaNode->schema.load(std::memory_order_acquire), std::memory_order_relaxed);
+static Object* RecyclePool_next_get(const Object* self) {
+	return reinterpret_cast<Object*>(const_cast<Schema*>(self->schema.load(std::memory_order_relaxed)));
 }
 
 
-__attribute__((noinline))
-void* Object_methods_get(const Object* self, void* dispatcher) {
-	if (!self || !dispatcher)
-		return NULL;
-	const Schema* schema = Object_schema_get(self);
-	void* const* method = schema->methods.find(dispatcher);
-	if (!method)
-		return NULL;
-	return *method;
+static void RecyclePool_next_set(Object* self, const Object* next) {
+	self->schema.store(reinterpret_cast<const Schema*>(next), std::memory_order_relaxed);
 }
 
 
-__attribute__((noinline))
-void* Object_supermethods_get(const Object* self, void* method) {
-	if (!self || !method)
-		return NULL;
-	const Schema* schema = Object_schema_get(self);
-	void* const* supermethod = schema->supermethods.find(method);
-	if (!supermethod)
-		return NULL;
-	return *supermethod;
+/** Pushes a list of kept objects from first to last onto the pool. */
+static void RecyclePool_push(RecyclePool* pool, Object* first, Object* last) {
+	Object* head = pool->head.load(std::memory_order_relaxed);
+	do {
+		RecyclePool_next_set(last, head);
+	} while (!pool->head.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
 }
 
 
-char* Object_inspect(const Object* self) {
-	if (!self)
-		return NULL;
+/** Unlinks a kept object, restoring its schema cache from its node as Object_schemaNode_set() does. */
+static Object* RecyclePool_unlink(Object* self) {
+	Object* next = RecyclePool_next_get(self);
+	self->schema.store(self->schemaNode->schema.load(std::memory_order_acquire), std::memory_order_relaxed);
+	return next;
+}
 
-	size_t capacity = 1024;
-	size_t pos = 0;
-	char* s = (char*) malloc(capacity);
-	if (!s)
-		return NULL;
 
-	uint64_t refs = self->refs.load();
-	uint32_t strong = refs & 0xFFFFFFFF;
-	uint32_t weak = refs >> 32;
-	int size = snprintf(s + pos, capacity - pos, "Object(%p)[%u,%u]:", self, strong, weak);
-	if (size < 0) {
-		free(s);
-		return NULL;
+/** Prepares a kept object to be handed out like a new one. */
+static Object* Object_recycled_revive(Object* self) {
+#if defined OBJECT_BIASED_REFS
+	Object_refs_bias(self);
+#endif
+	alive.fetch_add(1, std::memory_order_relaxed);
+	return self;
+}
+
+
+/** Detaches a pool's kept objects, pushes back up to keep of those whose node is still registered, and links the rest onto freed. */
+static void RecyclePool_trim(RecyclePool* pool, uint32_t keep, Object*& freed) {
+	Object* self = pool->head.exchange(NULL, std::memory_order_acquire);
+	const SchemaNode* node = pool->node.load(std::memory_order_relaxed);
+	Object* first = NULL;
+	Object* last = NULL;
+	while (self) {
+		Object* next = RecyclePool_unlink(self);
+		if (keep > 0 && self->schemaNode == node) {
+			RecyclePool_next_set(self, first);
+			first = self;
+			if (!last)
+				last = self;
+			keep--;
+		}
+		else {
+			pool->count.fetch_sub(1, std::memory_order_relaxed);
+			RecyclePool_next_set(self, freed);
+			freed = self;
+		}
+		self = next;
 	}
-	pos += size;
+	if (first)
+		RecyclePool_push(pool, first, last);
+}
+
 
-	// Collect classes in push order
-	std::vector<const Class*> classes;
-	for (const SchemaNode* n = self->schemaNode; n; n = n->parent) {
-		if (n->delta.type == SchemaDelta::CLASS)
-			classes.push_back(n->delta.cls);
+/** Frees objects linked by RecyclePool_trim(), which are no longer kept. */
+static void RecyclePool_free(Object* freed) {
+	while (freed) {
+		Object* next = RecyclePool_unlink(freed);
+		Object_unref(Object_recycled_revive(freed));
+		freed = next;
 	}
+}
 
-	for (size_t i = classes.size(); i > 0; i--) {
-		const Class* cls = classes[i - 1];
-		void* slot = Object_slots_get(self, cls);
-		size = snprintf(s + pos, capacity - pos, " %s(%p)", cls->name, slot);
-		if (size < 0)
-			break;
-		pos += size;
-		if (pos >= capacity) {
-			pos = capacity - 1;
-			break;
-		}
+
+/** Resets and keeps an object whose strong refs reached zero, after Object_final_begin().
+Returns false if the object can't be kept, in which case it must be freed.
+*/
+static bool Object_recycle(const Object* self) {
+	Object* o = const_cast<Object*>(self);
+	// Shells reachable through weak refs, side records, or storage owned elsewhere can't be reused.
+	// The only weak ref left is Object_final_begin()'s, so no other thread can reach the object.
+	uint64_t refs = o->refs.load(std::memory_order_acquire);
+	if (refs & (Object::refsRegion | Object::refsExternal | Object::refsWeakBlock | Object::refsHandle))
+		return false;
+	if (((refs >> 32) & Object::refsWeakMask) != 1)
+		return false;
+	const Schema* schema = Object_classesSchema_get(self);
+	if (!schema || schema->slotIndices.size == 0)
+		return false;
+	for (uint32_t i = 0; i < schema->slotIndices.size; i++) {
+		if (!schema->classes[i]->reset)
+			return false;
 	}
-	s = (char*) realloc(s, pos + 1);
-	return s;
+	// Find the class whose _create() function returns objects of this node, usually the top class
+	const SchemaNode* node = self->schemaNode;
+	RecyclePool* pool = NULL;
+	for (uint32_t i = schema->slotIndices.size; i > 0 && !pool; i--) {
+		RecyclePool* p = RecyclePool_find(schema->classes[i - 1], false);
+		if (p && p->node.load(std::memory_order_relaxed) == node)
+			pool = p;
+	}
+	if (!pool)
+		return false;
+	// Reserve room before resetting, since reset() functions may release other objects kept in the same pool
+	if (pool->count.fetch_add(1, std::memory_order_relaxed) >= recyclePools.capacity.load(std::memory_order_relaxed)) {
+		pool->count.fetch_sub(1, std::memory_order_relaxed);
+		return false;
+	}
+	for (uint32_t i = schema->slotIndices.size; i > 0; i--)
+		schema->classes[i - 1]->reset(o);
+	// Drop Object_final_begin()'s weak ref and DEAD, leaving the strong ref that Object_recycled_take() hands out
+	o->refs.store(1, std::memory_order_relaxed);
+	alive.fetch_sub(1, std::memory_order_relaxed);
+	RecyclePool_push(pool, o, o);
+	// The class was registered with another node or unregistered meanwhile, so its pool may now hold objects that won't be taken
+	if (pool->node.load(std::memory_order_relaxed) != node) {
+		Object* freed = NULL;
+		RecyclePool_trim(pool, recyclePools.capacity.load(std::memory_order_relaxed), freed);
+		RecyclePool_free(freed);
+	}
+	return true;
 }
 
 
-uint64_t Object_alive_get() {
-	return alive.load(std::memory_order_relaxed);
+/** Frees an object's classes from top to bottom after Object_final_begin(), then its shell if no weak refs remain. */
+static void Object_final_free(const Object* self) {
+	if (recyclePools.capacity.load(std::memory_order_relaxed) > 0 && Object_recycle(self))
+		return;
+	// Remove all classes from top to bottom
+	const Schema* schema = Object_classesSchema_get(self);
+	if (schema && schema->slotIndices.size > 0)
+		Object_classes_remove(const_cast<Object*>(self), schema->classes[0]);
+	// Release the prevent-deletion weak reference, allowing the Object to be deleted if no other weak references remain.
+	Object_weak_unref(self);
 }
 
 
-uint64_t Object_schemaNodes_count_get() {
-	return SchemaNode_count_get(rootNode_get());
+struct ParallelWorker;
+
+
+/** Objects released by free() functions on the calling thread, waiting to be freed by the outermost release instead of recursively. */
+struct ThreadFrees {
+	/** Most recently released pending object, linked to the next by ThreadFrees_push(), so queueing never allocates. */
+	const Object* pending = NULL;
+	uint64_t pendingCount = 0;
+	/** Whether the thread is inside Object_final_unref(). */
+	bool freeing = false;
+	/** Maximum nanoseconds that one release spends freeing pending objects, or 0 for no limit. */
+	uint64_t budget = 0;
+	/** The Object_unref_parallel() worker run by the thread, which takes released objects instead of `pending`. */
+	ParallelWorker* worker = NULL;
+
+	~ThreadFrees();
+};
+
+static thread_local ThreadFrees threadFrees;
+
+
+/** Links a released object into the pending list through its cached schema pointer, which nothing reads until ThreadFrees_pop() restores it.
+Weak refs can't lock the object and its side records are detached, so no other thread reaches it meanwhile.
+*/
+static void ThreadFrees_push(ThreadFrees& frees, const Object* self) {
+	const_cast<Object*>(self)->schema.store(reinterpret_cast<const Schema*>(frees.pending), std::memory_order_relaxed);
+	frees.pending = self;
+	frees.pendingCount++;
+}
+
+
+static const Object* ThreadFrees_pop(ThreadFrees& frees) {
+	Object* self = const_cast<Object*>(frees.pending);
+	frees.pending = reinterpret_cast<const Object*>(self->schema.load(std::memory_order_relaxed));
+	frees.pendingCount--;
+	// Restore the schema cache from the object's node, as Object_schemaNode_set() does
+	self->schema.store(self->schemaNode->schema.load(std::memory_order_acquire), std::memory_order_relaxed);
+	return self;
+}
+
+
+/** Frees pending objects until none remain or the deadline passes.
+Returns the number of objects still pending.
+*/
+static uint64_t ThreadFrees_drain(ThreadFrees& frees, std::chrono::steady_clock::time_point deadline) {
+	frees.freeing = true;
+	while (frees.pending) {
+		if (frees.budget > 0 && std::chrono::steady_clock::now() >= deadline)
+			break;
+		Object_final_free(ThreadFrees_pop(frees));
+	}
+	frees.freeing = false;
+	return frees.pendingCount;
+}
+
+
+ThreadFrees::~ThreadFrees() {
+	// Don't leak objects left over by a time budget when the thread exits
+	budget = 0;
+	ThreadFrees_drain(*this, std::chrono::steady_clock::time_point());
+}
+
+
+static void ParallelWorker_push(ParallelWorker* worker, const Object* self);
+
+
+/** Frees an object after Object_final_begin(), then the objects released by its free() functions. */
+static void Object_final_run(const Object* self) {
+	ThreadFrees& frees = threadFrees;
+	std::chrono::steady_clock::time_point deadline;
+	if (frees.budget > 0)
+		deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(frees.budget);
+	frees.freeing = true;
+	Object_final_free(self);
+	ThreadFrees_drain(frees, deadline);
+}
+
+
+/** Frees an object after its strong refs reach zero.
+Objects released by its free() functions are appended to the thread's pending list and freed iteratively, so deep object graphs don't overflow the stack.
+*/
+static void Object_final_unref(const Object* self) {
+	Object_final_begin(self);
+	ThreadFrees& frees = threadFrees;
+	if (frees.worker) {
+		ParallelWorker_push(frees.worker, self);
+		return;
+	}
+	if (frees.freeing) {
+		ThreadFrees_push(frees, self);
+		return;
+	}
+	Object_final_run(self);
+}
+
+
+/** A thread freeing objects for Object_unref_parallel().
+Its owner takes objects from the back of its queue, and other workers steal from the front.
+*/
+struct alignas(64) ParallelWorker {
+	struct ParallelTeardown* teardown;
+	std::mutex mutex;
+	std::deque<const Object*, ObjectStdAllocator<const Object*, OBJECT_ALLOC_RUNTIME>> queue;
+};
+
+
+/** State shared by the workers of one Object_unref_parallel() call. */
+struct ParallelTeardown {
+	ParallelWorker* workers;
+	uint32_t workersCount;
+	/** Number of objects queued or being freed by workers. */
+	alignas(64) std::atomic<uint64_t> pending{0};
+	std::atomic<bool> done{false};
+	/** Number of pool threads still running a worker, which the calling thread waits out before the teardown goes away. */
+	std::atomic<uint32_t> helpers{0};
+	/** Objects with a CLASS_FLAG_FREE_SERIAL class, freed by the calling thread afterward. */
+	std::mutex serialMutex;
+	RuntimeVector<const Object*> serial;
+};
+
+
+static std::atomic<uint32_t> parallelThreads{0};
+
+
+static void ParallelWorker_push(ParallelWorker* worker, const Object* self) {
+	worker->teardown->pending.fetch_add(1, std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lock(worker->mutex);
+	worker->queue.push_back(self);
+}
+
+
+/** Takes an object from the worker's own queue, or steals one from another worker. */
+static const Object* ParallelWorker_pop(ParallelWorker* worker) {
+	{
+		std::lock_guard<std::mutex> lock(worker->mutex);
+		if (!worker->queue.empty()) {
+			const Object* self = worker->queue.back();
+			worker->queue.pop_back();
+			return self;
+		}
+	}
+	ParallelTeardown* teardown = worker->teardown;
+	uint32_t index = worker - teardown->workers;
+	for (uint32_t i = 1; i < teardown->workersCount; i++) {
+		ParallelWorker* victim = &teardown->workers[(index + i) % teardown->workersCount];
+		std::lock_guard<std::mutex> lock(victim->mutex);
+		if (!victim->queue.empty()) {
+			const Object* self = victim->queue.front();
+			victim->queue.pop_front();
+			return self;
+		}
+	}
+	return NULL;
+}
+
+
+/** Returns whether any of the object's classes must be freed on the thread that called Object_unref_parallel(). */
+static bool Object_freeSerial_is(const Object* self) {
+	const Schema* schema = Object_classesSchema_get(self);
+	if (!schema)
+		return false;
+	for (uint32_t i = 0; i < schema->slotIndices.size; i++) {
+		if (schema->classes[i]->flags & CLASS_FLAG_FREE_SERIAL)
+			return true;
+	}
+	return false;
+}
+
+
+/** Frees queued objects until the teardown is done.
+The calling thread's worker ends the teardown once no objects are pending.
+*/
+static void ParallelWorker_run(ParallelWorker* worker, bool caller) {
+	ParallelTeardown* teardown = worker->teardown;
+	ThreadFrees& frees = threadFrees;
+	frees.worker = worker;
+	while (true) {
+		const Object* self = ParallelWorker_pop(worker);
+		if (self) {
+			if (Object_freeSerial_is(self)) {
+				std::lock_guard<std::mutex> lock(teardown->serialMutex);
+				teardown->serial.push_back(self);
+			}
+			else {
+				Object_final_free(self);
+			}
+			// Objects released by free() were counted before this decrement
+			teardown->pending.fetch_sub(1, std::memory_order_acq_rel);
+			continue;
+		}
+		if (caller) {
+			bool idle = teardown->pending.load(std::memory_order_acquire) == 0;
+			// Workers may have released the last shared refs of objects whose biased refs this thread owns
+			Object_thread_refs_merge();
+			if (idle && teardown->pending.load(std::memory_order_acquire) == 0)
+				break;
+		}
+		else if (teardown->done.load(std::memory_order_acquire)) {
+			break;
+		}
+		std::this_thread::yield();
+	}
+	frees.worker = NULL;
+	if (caller)
+		teardown->done.store(true, std::memory_order_release);
+}
+
+
+/** Threads running the workers of Object_unref_parallel() calls, started on first use and kept for later calls. */
+struct ParallelPool {
+	/** Serializes Object_unref_parallel() calls, which share the pool's threads. */
+	std::mutex callMutex;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::vector<std::thread> threads;
+	/** The running teardown, or NULL between calls. */
+	ParallelTeardown* teardown = NULL;
+	/** Incremented for each teardown, so each thread joins it once. */
+	uint64_t generation = 0;
+	bool stopping = false;
+
+	~ParallelPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+};
+
+static ParallelPool parallelPool;
+
+
+/** Runs the worker at the thread's index in each teardown that has one. */
+static void ParallelPool_run(uint32_t index) {
+	uint64_t generation = 0;
+	std::unique_lock<std::mutex> lock(parallelPool.mutex);
+	while (true) {
+		parallelPool.wake.wait(lock, [&] {
+			return parallelPool.stopping || parallelPool.generation != generation;
+		});
+		if (parallelPool.stopping)
+			return;
+		generation = parallelPool.generation;
+		ParallelTeardown* teardown = parallelPool.teardown;
+		if (!teardown || index >= teardown->workersCount)
+			continue;
+		lock.unlock();
+		ParallelWorker_run(&teardown->workers[index], false);
+		teardown->helpers.fetch_sub(1, std::memory_order_release);
+		lock.lock();
+	}
+}
+
+
+/** Objects whose strong refs reached zero on a thread that defers unrefs, waiting for the reclaimer to free them. */
+struct DeferredUnrefs {
+	struct Entry {
+		const Object* object;
+		/** steady_clock time in nanoseconds when the object was queued. */
+		int64_t time;
+	};
+	BoundedQueue<Entry, 1 << 12> queue;
+	std::atomic<uint64_t> reclaimed{0};
+	std::atomic<uint64_t> overflows{0};
+	std::atomic<uint64_t> latencyTotal{0};
+	std::atomic<uint64_t> latencyMax{0};
+	std::atomic<bool> stopping{false};
+	/** Serializes starting and stopping the reclaimer thread. */
+	std::mutex mutex;
+	std::thread* thread = NULL;
+};
+
+static DeferredUnrefs deferredUnrefs;
+/** Whether the calling thread queues objects instead of freeing them, set by Object_thread_unref_deferred_set(). */
+static thread_local bool threadUnrefDeferred = false;
+
+
+static int64_t DeferredUnrefs_now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/** Queues an object with no strong refs left for the reclaimer.
+Never allocates or blocks, but frees the object on the calling thread if the queue is full.
+*/
+static void Object_final_defer(const Object* self) {
+	// Keep the shell alive while queued, since weak refs may be released meanwhile
+	Object_weak_ref(self);
+	if (!deferredUnrefs.queue.push({self, DeferredUnrefs_now()})) {
+		deferredUnrefs.overflows.fetch_add(1, std::memory_order_relaxed);
+		Object_final_unref(self);
+		Object_weak_unref(self);
+	}
+}
+
+
+/** Frees an object whose strong refs reached zero, or queues it if the calling thread defers unrefs. */
+static void Object_final_release(const Object* self) {
+	if (threadUnrefDeferred)
+		Object_final_defer(self);
+	else
+		Object_final_unref(self);
+}
+
+
+static uint64_t DeferredUnrefs_reclaim() {
+	uint64_t count = 0;
+	DeferredUnrefs::Entry entry;
+	while (deferredUnrefs.queue.pop(entry)) {
+		uint64_t latency = std::max<int64_t>(DeferredUnrefs_now() - entry.time, 0);
+		deferredUnrefs.latencyTotal.fetch_add(latency, std::memory_order_relaxed);
+		uint64_t latencyMax = deferredUnrefs.latencyMax.load(std::memory_order_relaxed);
+		while (latency > latencyMax && !deferredUnrefs.latencyMax.compare_exchange_weak(latencyMax, latency, std::memory_order_relaxed)) {}
+		// free() functions may unref other objects, which are freed on this thread
+		Object_final_unref(entry.object);
+		Object_weak_unref(entry.object);
+		deferredUnrefs.reclaimed.fetch_add(1, std::memory_order_relaxed);
+		count++;
+	}
+	return count;
+}
+
+
+/** A thread's RCU read-side state, reused by later threads once its thread exits. */
+struct alignas(64) RcuReader {
+	/** Global epoch observed when the thread entered its read-side section, or 0 outside one. */
+	std::atomic<uint64_t> epoch{0};
+	std::atomic<bool> used{true};
+	RcuReader* next = NULL;
+};
+
+
+/** Objects unpublished by Object_rcu_publish(), released once no reader can still see them. */
+struct Rcu {
+	/** Starts at 1, so 0 means a reader is outside its read-side section. */
+	std::atomic<uint64_t> epoch{1};
+	/** List of all reader records, which are never freed. */
+	std::atomic<RcuReader*> readers{NULL};
+
+	struct Retired {
+		const Object* object;
+		/** Global epoch after the object was unpublished. Readers that entered at this epoch or later can't see it. */
+		uint64_t epoch;
+	};
+	std::mutex retiredMutex;
+	RuntimeVector<Retired> retired;
+	std::atomic<uint64_t> retiredCount{0};
+};
+
+static Rcu rcu;
+
+
+/** The calling thread's reader record and read-side nesting depth. */
+struct RcuThread {
+	RcuReader* reader = NULL;
+	uint32_t depth = 0;
+
+	~RcuThread() {
+		if (reader)
+			reader->used.store(false, std::memory_order_release);
+	}
+};
+
+static thread_local RcuThread rcuThread;
+
+
+static RcuReader* RcuReader_acquire() {
+	for (RcuReader* reader = rcu.readers.load(std::memory_order_acquire); reader; reader = reader->next) {
+		bool used = false;
+		if (!reader->used.load(std::memory_order_relaxed) && reader->used.compare_exchange_strong(used, true, std::memory_order_acquire))
+			return reader;
+	}
+	RcuReader* reader = ObjectAllocator_new<RcuReader>(OBJECT_ALLOC_RUNTIME);
+	RcuReader* head = rcu.readers.load(std::memory_order_relaxed);
+	do {
+		reader->next = head;
+	} while (!rcu.readers.compare_exchange_weak(head, reader, std::memory_order_release, std::memory_order_relaxed));
+	return reader;
+}
+
+
+/** Returns the oldest epoch that a reader inside its read-side section entered at, or UINT64_MAX if none. */
+static uint64_t Rcu_readersEpoch_get() {
+	uint64_t oldest = UINT64_MAX;
+	for (RcuReader* reader = rcu.readers.load(std::memory_order_acquire); reader; reader = reader->next) {
+		uint64_t epoch = reader->epoch.load();
+		if (epoch != 0)
+			oldest = std::min(oldest, epoch);
+	}
+	return oldest;
+}
+
+
+/** Releases the retired objects that no reader can still see.
+Returns the number of objects still retired.
+*/
+static uint64_t Rcu_reclaim() {
+	if (rcu.retiredCount.load(std::memory_order_relaxed) == 0)
+		return 0;
+	RuntimeVector<const Object*> released;
+	uint64_t remaining;
+	{
+		// Only objects retired before the readers are scanned are considered.
+		// One retired afterward may have been read by a reader that entered after the scan but before it was unpublished.
+		uint64_t limit = rcu.epoch.load();
+		uint64_t oldest = std::min(limit, Rcu_readersEpoch_get());
+		std::lock_guard<std::mutex> lock(rcu.retiredMutex);
+		auto it = std::partition(rcu.retired.begin(), rcu.retired.end(), [&](const Rcu::Retired& retired) {
+			return retired.epoch > oldest;
+		});
+		for (auto it2 = it; it2 != rcu.retired.end(); ++it2)
+			released.push_back(it2->object);
+		rcu.retired.erase(it, rcu.retired.end());
+		remaining = rcu.retired.size();
+		rcu.retiredCount.store(remaining, std::memory_order_relaxed);
+	}
+	// Release outside the lock, since free() functions may publish other objects
+	Object_unref_array(released.data(), released.size());
+	return remaining;
+}
+
+
+static void DeferredUnrefs_run() {
+	while (!deferredUnrefs.stopping.load(std::memory_order_acquire)) {
+		DeferredUnrefs_reclaim();
+		Rcu_reclaim();
+		// Poll rather than wait on a condition variable, so queueing never makes a system call
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	DeferredUnrefs_reclaim();
+}
+
+
+/** Size and alignment of the chunks that regions allocate from, so the region of an object is found by masking its address. */
+static const size_t regionChunkSize = 64 * 1024;
+
+
+/** Header at the start of each region chunk. */
+struct alignas(64) RegionChunk {
+	ObjectRegion* region;
+	RegionChunk* next;
+};
+
+
+struct RegionLarge {
+	void* block;
+	size_t size;
+	size_t align;
+};
+
+
+struct ObjectRegion {
+	RegionChunk* chunks = NULL;
+	char* cursor = NULL;
+	char* end = NULL;
+	/** Allocations too large for a chunk. */
+	RuntimeVector<RegionLarge> large;
+	/** Objects in creation order, each holding one strong ref owned by the region. */
+	RuntimeVector<Object*> objects;
+};
+
+/** Region that Object_create() creates objects in on the calling thread. */
+static thread_local ObjectRegion* threadRegion = NULL;
+
+
+static void* ObjectRegion_alloc(ObjectRegion* region, size_t size, size_t align) {
+	uintptr_t p = (uintptr_t(region->cursor) + align - 1) & ~uintptr_t(align - 1);
+	if (region->cursor && p + size <= uintptr_t(region->end)) {
+		region->cursor = (char*) (p + size);
+		return (void*) p;
+	}
+	if (size + align > regionChunkSize - sizeof(RegionChunk)) {
+		void* block = ObjectAllocator_alloc(OBJECT_ALLOC_RUNTIME, size, align);
+		region->large.push_back({block, size, align});
+		return block;
+	}
+	RegionChunk* chunk = (RegionChunk*) ObjectAllocator_alloc(OBJECT_ALLOC_RUNTIME, regionChunkSize, regionChunkSize);
+	chunk->region = region;
+	chunk->next = region->chunks;
+	region->chunks = chunk;
+	region->cursor = (char*) (chunk + 1);
+	region->end = (char*) chunk + regionChunkSize;
+	return ObjectRegion_alloc(region, size, align);
+}
+
+
+/** Returns the region of an object, from the header of the chunk containing its shell. */
+static ObjectRegion* Object_region_find(const Object* self) {
+	if (!(self->refs.load(std::memory_order_relaxed) & Object::refsRegion))
+		return NULL;
+	return ((const RegionChunk*) (uintptr_t(self) & ~uintptr_t(regionChunkSize - 1)))->region;
+}
+
+
+/** Constructs an object shell in memory that the runtime doesn't delete, with a strong ref owned by that memory's owner.
+`flag` is Object::refsRegion or Object::refsExternal.
+*/
+static Object* Object_storage_construct(void* memory, uint64_t flag) {
+	Object* self = new (memory) Object;
+	self->refs.store(1 | flag, std::memory_order_relaxed);
+#if defined OBJECT_BIASED_REFS
+	// Count refs atomically from the start, so no owner thread must merge them before the storage is released on any thread
+	self->owner.store(NULL, std::memory_order_relaxed);
+	self->biasedRefs.store(0, std::memory_order_relaxed);
+	self->sharedRefs.store(Object::sharedMerged | (Object::sharedZero + 1), std::memory_order_relaxed);
+#endif
+	return self;
+}
+
+
+/** Constructs an object shell in a region. */
+static Object* ObjectRegion_object_create(ObjectRegion* region) {
+	Object* self = Object_storage_construct(ObjectRegion_alloc(region, sizeof(Object), alignof(Object)), Object::refsRegion);
+	region->objects.push_back(self);
+	return self;
+}
+
+
+/** Releases the storage owner's ref of each object, newest first, and frees objects still referenced elsewhere, since their storage is about to be reused.
+Objects are freed synchronously on the calling thread.
+Unless NDEBUG is defined, reports the escaped objects on stderr and aborts.
+*/
+static void Object_storage_release(Object* const* objects, size_t count, const char* storage) {
+	// Free objects synchronously on this thread, since their memory is released afterwards
+	ThreadFrees& frees = threadFrees;
+	bool deferred = threadUnrefDeferred;
+	threadUnrefDeferred = false;
+	bool freeing = frees.freeing;
+	frees.freeing = false;
+	uint64_t budget = frees.budget;
+	frees.budget = 0;
+	ParallelWorker* worker = frees.worker;
+	frees.worker = NULL;
+
+	// Newest first, so free() functions release refs to older objects before their turn
+	for (size_t i = count; i-- > 0;)
+		Object_unref(objects[i]);
+
+	// Objects with refs left are referenced from outside the storage
+	uint64_t escapes = 0;
+	for (size_t i = 0; i < count; i++) {
+		uint64_t refs = objects[i]->refs.load(std::memory_order_acquire);
+		if ((refs & Object::refsDead) && ((refs >> 32) & Object::refsWeakMask) == 0 && !(refs & Object::refsImmortal))
+			continue;
+		escapes++;
+#if !defined NDEBUG
+		char* s = Object_inspect(objects[i]);
+		fprintf(stderr, "Object: %s escaped its %s\n", s, storage);
+		free(s);
+#else
+		(void) storage;
+#endif
+	}
+#if !defined NDEBUG
+	if (escapes > 0)
+		abort();
+#endif
+
+	// Free escaped objects anyway, then forget their remaining weak refs
+	for (size_t i = count; escapes > 0 && i-- > 0;) {
+		Object* self = objects[i];
+		uint64_t refs = self->refs.load(std::memory_order_acquire);
+		if (!(refs & Object::refsDead)) {
+#if defined OBJECT_BIASED_REFS
+			self->sharedRefs.store(Object::sharedMerged | Object::sharedZero, std::memory_order_relaxed);
+#else
+			self->refs.fetch_or(Object::refsDead, std::memory_order_acquire);
+#endif
+			Object_final_begin(self);
+			Object_final_run(self);
+			refs = self->refs.load(std::memory_order_acquire);
+		}
+		if (((refs >> 32) & Object::refsWeakMask) != 0 || (refs & Object::refsImmortal)) {
+			alive.fetch_sub(1, std::memory_order_relaxed);
+			SchemaNode_release(self->schemaNode);
+			if (!(refs & Object::refsRegion))
+				Object_slotsSpill_free(self->slotsSpill);
+		}
+	}
+
+	threadUnrefDeferred = deferred;
+	frees.freeing = freeing;
+	frees.budget = budget;
+	frees.worker = worker;
+}
+
+
+#if defined OBJECT_BIASED_REFS
+
+/** Per-thread record identifying the owner of biased reference counts.
+Records outlive their thread until every object they own is merged.
+*/
+struct ObjectOwner {
+	/** Objects whose sharedRefs went negative, waiting for the owner to merge them, linked by Object::mergeNext.
+	Set to `closed` when the thread exits.
+	*/
+	std::atomic<Object*> mergeQueue{NULL};
+	/** 1 for the live thread, plus 1 for each unmerged object.
+	A queued object's count passes to its queue entry.
+	*/
+	std::atomic<uint64_t> refs{1};
+
+	static Object* const closed;
+};
+
+Object* const ObjectOwner::closed = (Object*) 1;
+
+/** Owner of threads that haven't created an object, which owns no objects. */
+static ObjectOwner ownerNone;
+static thread_local ObjectOwner* threadOwner = &ownerNone;
+
+
+static void ObjectOwner_release(const ObjectOwner* owner) {
+	if (const_cast<ObjectOwner*>(owner)->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		ObjectAllocator_delete(OBJECT_ALLOC_RUNTIME, owner);
+}
+
+
+/** Moves the owner's biased refs into sharedRefs, after which every thread counts in sharedRefs.
+Returns true if no strong refs remain, in which case the caller must call Object_final_release().
+Must be called by the owner thread, or by any thread once the owner has exited.
+*/
+static bool Object_refs_merge(const Object* self) {
+	Object* o = const_cast<Object*>(self);
+	const ObjectOwner* owner = o->owner.load(std::memory_order_relaxed);
+	uint32_t biased = o->biasedRefs.load(std::memory_order_relaxed);
+	o->biasedRefs.store(0, std::memory_order_relaxed);
+	o->owner.store(NULL, std::memory_order_relaxed);
+	uint64_t shared = o->sharedRefs.load(std::memory_order_relaxed);
+	uint64_t merged;
+	do {
+		merged = (shared + biased) | Object::sharedMerged;
+	} while (!o->sharedRefs.compare_exchange_weak(shared, merged, std::memory_order_acq_rel, std::memory_order_relaxed));
+	// A queued object's hold on its owner is released with its queue entry
+	if (!(merged & Object::sharedQueued))
+		ObjectOwner_release(owner);
+	return (merged & 0xFFFFFFFF) == Object::sharedZero;
+}
+
+
+/** Merges the objects in a detached merge queue, releasing the weak refs that kept their shells alive. */
+static void ObjectOwner_queue_merge(ObjectOwner* owner, Object* head) {
+	while (head) {
+		Object* next = head->mergeNext;
+		// The owner may have merged the object itself since it was queued
+		bool release = !(head->sharedRefs.load(std::memory_order_acquire) & Object::sharedMerged) && Object_refs_merge(head);
+		// Drop the queue's weak ref first, so it doesn't stop the object from being recycled.
+		// The shell outlives it, since DEAD isn't set until Object_final_begin().
+		Object_weak_unref(head);
+		if (release)
+			Object_final_release(head);
+		ObjectOwner_release(owner);
+		head = next;
+	}
+}
+
+
+/** Queues an object for its owner to merge.
+The caller must hold a weak ref, which keeps the shell alive until the owner merges it.
+*/
+static void ObjectOwner_queue_push(ObjectOwner* owner, const Object* self) {
+	Object* o = const_cast<Object*>(self);
+	Object* head = owner->mergeQueue.load(std::memory_order_acquire);
+	do {
+		if (head == ObjectOwner::closed) {
+			// The owner exited, so its biased refs are final and any thread may merge them, unless the owner merged them itself
+			bool release = !(o->sharedRefs.load(std::memory_order_acquire) & Object::sharedMerged) && Object_refs_merge(self);
+			Object_weak_unref(self);
+			if (release)
+				Object_final_release(self);
+			ObjectOwner_release(owner);
+			return;
+		}
+		o->mergeNext = head;
+	} while (!owner->mergeQueue.compare_exchange_weak(head, o, std::memory_order_release, std::memory_order_acquire));
+}
+
+
+struct ObjectOwnerExit {
+	~ObjectOwnerExit() {
+		ObjectOwner* owner = threadOwner;
+		threadOwner = &ownerNone;
+		ObjectOwner_queue_merge(owner, owner->mergeQueue.exchange(ObjectOwner::closed, std::memory_order_acq_rel));
+		ObjectOwner_release(owner);
+	}
+};
+
+
+static ObjectOwner* ObjectOwner_thread_get() {
+	if (threadOwner == &ownerNone) {
+		threadOwner = ObjectAllocator_new<ObjectOwner>(OBJECT_ALLOC_RUNTIME);
+		// Close the queue when the thread exits
+		static thread_local ObjectOwnerExit exit;
+		(void) exit;
+	}
+	return threadOwner;
+}
+
+
+void Object_thread_refs_merge() {
+	ObjectOwner* owner = threadOwner;
+	if (owner == &ownerNone)
+		return;
+	if (!owner->mergeQueue.load(std::memory_order_relaxed))
+		return;
+	ObjectOwner_queue_merge(owner, owner->mergeQueue.exchange(NULL, std::memory_order_acquire));
+}
+
+
+/** Biases a recycled object's refs toward the calling thread, like a new object's. */
+static void Object_refs_bias(Object* self) {
+	Object_thread_refs_merge();
+	ObjectOwner* owner = ObjectOwner_thread_get();
+	owner->refs.fetch_add(1, std::memory_order_relaxed);
+	self->owner.store(owner, std::memory_order_relaxed);
+	self->biasedRefs.store(1, std::memory_order_relaxed);
+	self->sharedRefs.store(Object::sharedZero, std::memory_order_relaxed);
+	self->mergeNext = NULL;
+}
+
+
+Object* Object_create_in(ObjectRegion* region) {
+	// Merge objects released by other threads, since creating an object is already a slow path
+	Object_thread_refs_merge();
+	if (region) {
+		Object* self = ObjectRegion_object_create(region);
+		alive.fetch_add(1, std::memory_order_relaxed);
+		return self;
+	}
+	Object* self = ObjectAllocator_new<Object>(OBJECT_ALLOC_OBJECTS);
+	// assert(self);
+	ObjectOwner_thread_get()->refs.fetch_add(1, std::memory_order_relaxed);
+	alive.fetch_add(1, std::memory_order_relaxed);
+	return self;
+}
+
+
+/** Adds n strong refs to a non-NULL object. */
+static inline void Object_refs_increase(const Object* self, uint32_t n) {
+	Object* o = const_cast<Object*>(self);
+	if (o->refs.load(std::memory_order_relaxed) & Object::refsImmortal)
+		return;
+	if (o->owner.load(std::memory_order_relaxed) == threadOwner) {
+		o->biasedRefs.store(o->biasedRefs.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+		return;
+	}
+	// This check isn't part of the thread-safety guarantee, but it protects against obtaining a reference within a free() function.
+	uint64_t shared = o->sharedRefs.load(std::memory_order_relaxed);
+	if ((shared & Object::sharedMerged) && (shared & 0xFFFFFFFF) == Object::sharedZero)
+		return;
+	o->sharedRefs.fetch_add(n, std::memory_order_relaxed);
+}
+
+
+/** Removes n strong refs from a non-NULL object.
+Returns true if no strong refs remain, in which case the caller must call Object_final_release().
+*/
+static inline bool Object_refs_decrease(const Object* self, uint32_t n) {
+	Object* o = const_cast<Object*>(self);
+	if (o->refs.load(std::memory_order_relaxed) & Object::refsImmortal)
+		return false;
+	const ObjectOwner* owner = o->owner.load(std::memory_order_relaxed);
+	if (owner == threadOwner) {
+		uint32_t biased = o->biasedRefs.load(std::memory_order_relaxed);
+		if (n < biased) {
+			o->biasedRefs.store(biased - n, std::memory_order_relaxed);
+			return false;
+		}
+		// Batched releases may exceed the biased count, so the rest come from the shared count after merging
+		o->biasedRefs.store(0, std::memory_order_relaxed);
+		bool released = Object_refs_merge(self);
+		if (n == biased)
+			return released;
+		n -= biased;
+		owner = NULL;
+	}
+	// This check isn't part of the thread-safety guarantee, but it protects against releasing a reference within a free() function.
+	uint64_t shared = o->sharedRefs.load(std::memory_order_relaxed);
+	if ((shared & Object::sharedMerged) && (shared & 0xFFFFFFFF) == Object::sharedZero)
+		return false;
+	// Unmerged decrements are folded in by the merge, but the owner must be told once its refs may be the last ones.
+	// The decrement and the QUEUED flag are set together, since the owner may merge and free the object as soon as this thread's ref is gone.
+	// A NULL owner means a merge is in progress.
+	bool weak = false;
+	while (!(shared & Object::sharedMerged)) {
+		bool queue = owner && !(shared & Object::sharedQueued) && (shared & 0xFFFFFFFF) < Object::sharedZero + n;
+		// Keep the shell alive until it is queued
+		if (queue && !weak) {
+			Object_weak_ref(self);
+			weak = true;
+		}
+		if (o->sharedRefs.compare_exchange_weak(shared, (shared - n) | (queue ? Object::sharedQueued : 0), std::memory_order_release, std::memory_order_relaxed)) {
+			// Queueing the object keeps its owner record alive
+			if (queue)
+				ObjectOwner_queue_push(const_cast<ObjectOwner*>(owner), self);
+			else if (weak)
+				Object_weak_unref(self);
+			return false;
+		}
+	}
+	if (weak)
+		Object_weak_unref(self);
+	shared = o->sharedRefs.fetch_sub(n, std::memory_order_release);
+	if ((shared & 0xFFFFFFFF) != Object::sharedZero + n)
+		return false;
+	// Acquire the writes released by other threads' decrements.
+	// An acquire load rather than a fence, since ThreadSanitizer doesn't model fences.
+	(void) o->sharedRefs.load(std::memory_order_acquire);
+	return true;
+}
+
+
+uint32_t Object_refs_get(const Object* self) {
+	if (!self)
+		return 0;
+	if (self->refs.load(std::memory_order_relaxed) & Object::refsImmortal)
+		return UINT32_MAX;
+	uint64_t shared = self->sharedRefs.load();
+	int64_t refs = int64_t(shared & 0xFFFFFFFF) - int64_t(Object::sharedZero);
+	if (!(shared & Object::sharedMerged))
+		refs += self->biasedRefs.load(std::memory_order_relaxed);
+	return refs > 0 ? refs : 0;
+}
+
+
+bool Object_weak_lock(const Object* self) {
+	if (!self)
+		return false;
+	Object* o = const_cast<Object*>(self);
+	if (o->refs.load(std::memory_order_relaxed) & Object::refsImmortal)
+		return true;
+	// The owner's biased refs are nonzero until merged
+	if (o->owner.load(std::memory_order_relaxed) == threadOwner) {
+		o->biasedRefs.store(o->biasedRefs.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return true;
+	}
+	// Unmerged objects are alive until the merge, which counts every increment made before it
+	uint64_t shared = o->sharedRefs.load();
+	while (!(shared & Object::sharedMerged) || (shared & 0xFFFFFFFF) != Object::sharedZero) {
+		if (o->sharedRefs.compare_exchange_weak(shared, shared + 1))
+			return true;
+	}
+	return false;
+}
+
+#else
+
+void Object_thread_refs_merge() {
+}
+
+
+Object* Object_create_in(ObjectRegion* region) {
+	Object* self = region ? ObjectRegion_object_create(region) : ObjectAllocator_new<Object>(OBJECT_ALLOC_OBJECTS);
+	// assert(self);
+	alive.fetch_add(1, std::memory_order_relaxed);
+	return self;
+}
+
+
+/** Adds n strong refs to a non-NULL object. */
+static inline void Object_refs_increase(const Object* self, uint32_t n) {
+	// This check isn't part of the thread-safety guarantee, but it protects against obtaining a reference within a free() function.
+	uint64_t refs = self->refs.load(std::memory_order_relaxed);
+	if (refs & (Object::refsDead | Object::refsImmortal))
+		return;
+	// Increment strong reference count.
+	// The caller already holds a reference, so the increment needs no ordering.
+	const_cast<Object*>(self)->refs.fetch_add(n, std::memory_order_relaxed);
+}
+
+
+/** Removes n strong refs from a non-NULL object.
+Returns true if no strong refs remain, in which case the caller must call Object_final_release().
+*/
+static inline bool Object_refs_decrease(const Object* self, uint32_t n) {
+	// This check isn't part of the thread-safety guarantee, but it protects against releasing a reference within a free() function.
+	uint64_t refs = self->refs.load(std::memory_order_relaxed);
+	if (refs & (Object::refsDead | Object::refsImmortal))
+		return false;
+	// Decrement strong reference count, releasing this thread's writes to whichever thread frees the object
+	refs = const_cast<Object*>(self)->refs.fetch_sub(n, std::memory_order_release);
+	if ((refs & Object::refsStrongMask) != n)
+		return false;
+	// Mark the object dead, unless Object_weak_lock() revived it since the decrement.
+	// Acquires the writes released by other threads' decrements.
+	refs -= n;
+	// A failed CAS can also find DEAD, if a revived object was released and marked dead by another thread, which then freed it.
+	while (!const_cast<Object*>(self)->refs.compare_exchange_weak(refs, refs | Object::refsDead, std::memory_order_acquire, std::memory_order_relaxed)) {
+		if (refs & (Object::refsStrongMask | Object::refsDead))
+			return false;
+	}
+	return true;
+}
+
+
+uint32_t Object_refs_get(const Object* self) {
+	if (!self)
+		return 0;
+	uint64_t refs = self->refs.load();
+	if (refs & Object::refsImmortal)
+		return UINT32_MAX;
+	if (refs & Object::refsDead)
+		return 0;
+	return refs & Object::refsStrongMask;
+}
+
+
+bool Object_weak_lock(const Object* self) {
+	if (!self)
+		return false;
+	if (self->refs.load(std::memory_order_relaxed) & Object::refsImmortal)
+		return true;
+	// Increment unconditionally, so contending threads never retry.
+	// DEAD is sticky, so if it's clear, the strong refs were nonzero or are revived by this increment before the last release marks the object dead.
+	uint64_t refs = const_cast<Object*>(self)->refs.fetch_add(1, std::memory_order_acquire);
+	if (!(refs & Object::refsDead))
+		return true;
+	const_cast<Object*>(self)->refs.fetch_sub(1, std::memory_order_relaxed);
+	return false;
+}
+
+#endif
+
+
+Object* Object_create() {
+	return Object_create_in(threadRegion);
+}
+
+
+void Object_ref(const Object* self) {
+	if (!self)
+		return;
+	Object_refs_increase(self, 1);
+}
+
+
+void Object_refs_add(const Object* self, uint32_t count) {
+	if (!self || count == 0)
+		return;
+	Object_refs_increase(self, count);
+}
+
+
+void Object_unref(const Object* self) {
+	if (!self)
+		return;
+	if (Object_refs_decrease(self, 1))
+		Object_final_release(self);
+}
+
+
+void Object_refs_remove(const Object* self, uint32_t count) {
+	if (!self || count == 0)
+		return;
+	if (Object_refs_decrease(self, count))
+		Object_final_release(self);
+}
+
+
+void Object_unref_deferred(const Object* self) {
+	if (!self)
+		return;
+	if (Object_refs_decrease(self, 1))
+		Object_final_defer(self);
+}
+
+
+/** Number of array entries processed between teardown passes in Object_unref_array(). */
+static const uint32_t refsBatch = 64;
+/** Number of array entries to prefetch ahead of the one being processed. */
+static const uint32_t refsPrefetchDistance = 8;
+
+
+/** Counts the run of entries equal to objects[i], and prefetches the refs of the entry beyond the run. */
+static inline uint32_t Object_array_run_get(const Object* const* objects, uint64_t count, uint64_t i) {
+	const Object* self = objects[i];
+	uint32_t n = 1;
+	while (i + n < count && objects[i + n] == self && n < UINT32_MAX)
+		n++;
+	if (i + n + refsPrefetchDistance < count) {
+		const Object* ahead = objects[i + n + refsPrefetchDistance];
+		if (ahead)
+			__builtin_prefetch(&ahead->refs, 1);
+	}
+	return n;
+}
+
+
+void Object_ref_array(const Object* const* objects, uint64_t count) {
+	if (!objects)
+		return;
+	for (uint64_t i = 0; i < count;) {
+		uint32_t n = Object_array_run_get(objects, count, i);
+		if (objects[i])
+			Object_refs_increase(objects[i], n);
+		i += n;
+	}
+}
+
+
+void Object_unref_array(const Object* const* objects, uint64_t count) {
+	if (!objects)
+		return;
+	for (uint64_t i = 0; i < count;) {
+		// Decrement a batch of entries, collecting objects with no strong refs left
+		const Object* released[refsBatch];
+		uint32_t releasedCount = 0;
+		for (uint64_t end = std::min<uint64_t>(i + refsBatch, count); i < end;) {
+			// A run may extend past the end of the batch, but each run adds at most one released object
+			uint32_t n = Object_array_run_get(objects, count, i);
+			if (objects[i] && Object_refs_decrease(objects[i], n))
+				released[releasedCount++] = objects[i];
+			i += n;
+		}
+		// Free them after the decrement pass, so free() functions that unref other objects don't interleave with it
+		for (uint32_t j = 0; j < releasedCount; j++)
+			Object_final_release(released[j]);
+	}
+}
+
+
+void Object_weak_ref(const Object* self) {
+	if (!self)
+		return;
+	if (self->refs.load(std::memory_order_relaxed) & Object::refsImmortal)
+		return;
+	const_cast<Object*>(self)->refs.fetch_add(uint64_t(1) << 32, std::memory_order_relaxed);
+}
+
+
+void Object_weak_unref(const Object* self) {
+	if (!self)
+		return;
+	uint64_t refs = self->refs.load(std::memory_order_relaxed);
+	if (((refs >> 32) & Object::refsWeakMask) == 0 || (refs & Object::refsImmortal))
+		return;
+	// Decrement weak reference count
+	refs = const_cast<Object*>(self)->refs.fetch_sub(uint64_t(1) << 32, std::memory_order_release);
+	uint32_t refs_weak = (refs >> 32) & Object::refsWeakMask;
+	// Free Object shell if this was the last weak ref and strong refs are already gone
+	if (refs_weak == 1 && (refs & Object::refsDead)) {
+		(void) self->refs.load(std::memory_order_acquire);
+		alive.fetch_sub(1, std::memory_order_relaxed);
+		SchemaNode_release(self->schemaNode);
+		// Region memory is released by Object_region_destroy()
+		if (refs & Object::refsRegion)
+			return;
+		Object_slotsSpill_free(self->slotsSpill);
+		// Storage passed to Object_init_in() belongs to the caller
+		if (refs & Object::refsExternal)
+			return;
+		ObjectAllocator_delete(OBJECT_ALLOC_OBJECTS, self);
+	}
+}
+
+
+uint32_t Object_weak_refs_get(const Object* self) {
+	if (!self)
+		return 0;
+	uint64_t refs = self->refs.load();
+	if (refs & Object::refsImmortal)
+		return UINT32_MAX;
+	return (refs >> 32) & Object::refsWeakMask;
+}
+
+
+void Object_immortalize(const Object* self) {
+	if (!self)
+		return;
+	const_cast<Object*>(self)->refs.fetch_or(Object::refsImmortal);
+}
+
+
+bool Object_immortal_is(const Object* self) {
+	if (!self)
+		return false;
+	return self->refs.load(std::memory_order_relaxed) & Object::refsImmortal;
+}
+
+
+ObjectWeak* ObjectWeak_get(const Object* self) {
+	if (!self)
+		return NULL;
+	SideTable::Stripe& stripe = sideTable.stripe_get(self);
+	std::lock_guard<std::mutex> lock(stripe.mutex);
+	// Objects being freed can't get a block, since they were already unlinked
+	if (self->refs.load(std::memory_order_relaxed) & Object::refsDead)
+		return NULL;
+	ObjectWeak*& weak = stripe.sides[self].weak;
+	if (!weak) {
+		weak = ObjectAllocator_new<ObjectWeak>(OBJECT_ALLOC_RUNTIME);
+		weak->object.store(self, std::memory_order_relaxed);
+		weak->refs.store(1, std::memory_order_relaxed);
+		const_cast<Object*>(self)->refs.fetch_or(Object::refsWeakBlock, std::memory_order_relaxed);
+	}
+	weak->refs.fetch_add(1, std::memory_order_relaxed);
+	return weak;
+}
+
+
+void ObjectWeak_ref(ObjectWeak* weak) {
+	if (!weak)
+		return;
+	weak->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void ObjectWeak_unref(ObjectWeak* weak) {
+	if (!weak)
+		return;
+	if (weak->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		ObjectAllocator_delete(OBJECT_ALLOC_RUNTIME, weak);
+}
+
+
+Object* ObjectWeak_lock(ObjectWeak* weak) {
+	if (!weak)
+		return NULL;
+	const Object* self = weak->object.load(std::memory_order_relaxed);
+	if (!self)
+		return NULL;
+	// The object is unlinked under its stripe's lock before it can be freed, so it's safe to lock while still linked
+	SideTable::Stripe& stripe = sideTable.stripe_get(self);
+	std::lock_guard<std::mutex> lock(stripe.mutex);
+	if (weak->object.load(std::memory_order_relaxed) != self)
+		return NULL;
+	if (!Object_weak_lock(self))
+		return NULL;
+	return const_cast<Object*>(self);
+}
+
+
+bool ObjectWeak_alive_is(const ObjectWeak* weak) {
+	if (!weak)
+		return false;
+	return weak->object.load(std::memory_order_relaxed);
+}
+
+
+ObjectHandle Object_handle_get(const Object* self) {
+	if (!self)
+		return 0;
+	SideTable::Stripe& stripe = sideTable.stripe_get(self);
+	std::lock_guard<std::mutex> lock(stripe.mutex);
+	// Objects being freed can't get a handle, since they were already unlinked
+	if (self->refs.load(std::memory_order_relaxed) & Object::refsDead)
+		return 0;
+	ObjectSide& side = stripe.sides[self];
+	uint32_t& index = side.handleIndex;
+	if (!index) {
+		index = HandleTable_alloc();
+		if (!index) {
+			if (!side.weak)
+				stripe.sides.erase(self);
+			return 0;
+		}
+		HandleEntry* entry = HandleTable_entry_get(index);
+		Object_weak_ref(self);
+		entry->object = self;
+		// Publish the object, keeping the generation bumped when the entry was last freed
+		uint64_t generation = entry->word.load(std::memory_order_relaxed) >> 32;
+		if (generation == 0)
+			generation = 1;
+		entry->word.store(generation << 32, std::memory_order_release);
+		const_cast<Object*>(self)->refs.fetch_or(Object::refsHandle, std::memory_order_relaxed);
+	}
+	uint64_t generation = HandleTable_entry_get(index)->word.load(std::memory_order_relaxed) >> 32;
+	return generation << 32 | index;
+}
+
+
+/** Returns the entry of a handle if the index has been allocated, without checking the generation. */
+static HandleEntry* HandleTable_handleEntry_get(ObjectHandle handle) {
+	uint32_t index = (uint32_t) handle;
+	if (index == 0 || index >= handleTable.used.load(std::memory_order_relaxed) || index / HandleTable::chunkSize >= LENGTHOF(handleTable.chunks))
+		return NULL;
+	HandleEntry* chunk = handleTable.chunks[index / HandleTable::chunkSize].load(std::memory_order_acquire);
+	if (!chunk)
+		return NULL;
+	return &chunk[index % HandleTable::chunkSize];
+}
+
+
+Object* Object_handle_lock(ObjectHandle handle) {
+	HandleEntry* entry = HandleTable_handleEntry_get(handle);
+	if (!entry)
+		return NULL;
+	// Pin the entry so its weak ref keeps the object's shell allocated while locking
+	uint64_t word = entry->word.load(std::memory_order_relaxed);
+	do {
+		if ((word >> 32) != (handle >> 32) || (word & HandleEntry::dead))
+			return NULL;
+	} while (!entry->word.compare_exchange_weak(word, word + 1, std::memory_order_acquire, std::memory_order_relaxed));
+	const Object* self = entry->object;
+	bool locked = Object_weak_lock(self);
+	HandleTable_unpin((uint32_t) handle);
+	return locked ? const_cast<Object*>(self) : NULL;
+}
+
+
+bool Object_handle_alive_is(ObjectHandle handle) {
+	HandleEntry* entry = HandleTable_handleEntry_get(handle);
+	if (!entry)
+		return false;
+	uint64_t word = entry->word.load(std::memory_order_acquire);
+	return (word >> 32) == (handle >> 32) && !(word & HandleEntry::dead);
+}
+
+
+/** Runtime-allocated slots up to slotPoolsMaxSize bytes are rounded up to a multiple of slotPoolsGranule, and freed slots are kept in per-thread pools for each size class.
+Slots of different classes share a pool if they round to the same size.
+*/
+static const uint32_t slotPoolsGranule = 16;
+static const uint32_t slotPoolsMaxSize = 512;
+static const uint32_t slotPoolsSizeClasses = slotPoolsMaxSize / slotPoolsGranule;
+/** Freed slots kept per size class before they're returned to the OBJECT_ALLOC_SLOTS allocator. */
+static const uint32_t slotPoolsCapacity = 64;
+
+struct SlotPoolBlock {
+	SlotPoolBlock* next;
+};
+
+struct SlotPools {
+	SlotPoolBlock* heads[slotPoolsSizeClasses];
+	uint32_t counts[slotPoolsSizeClasses];
+	/** Set once the thread exits, after which freed slots go straight to the allocator. */
+	bool closed;
+};
+
+/** Zero-initialized, so threads freeing slots during thread-local destruction still find a usable pool. */
+static thread_local SlotPools slotPools;
+
+
+static size_t SlotPools_align_get(const Class* cls) {
+	return cls->slotAlign ? cls->slotAlign : alignof(std::max_align_t);
+}
+
+
+/** Returns the size class of a slot, or slotPoolsSizeClasses if it isn't pooled. */
+static uint32_t SlotPools_sizeClass_get(size_t size, size_t align) {
+	if (size > slotPoolsMaxSize || align > slotPoolsGranule)
+		return slotPoolsSizeClasses;
+	return uint32_t((size + slotPoolsGranule - 1) / slotPoolsGranule) - 1;
+}
+
+
+struct SlotPoolsExit {
+	~SlotPoolsExit() {
+		slotPools.closed = true;
+		for (uint32_t sizeClass = 0; sizeClass < slotPoolsSizeClasses; sizeClass++) {
+			while (SlotPoolBlock* block = slotPools.heads[sizeClass]) {
+				slotPools.heads[sizeClass] = block->next;
+				ObjectAllocator_free(OBJECT_ALLOC_SLOTS, block, (sizeClass + 1) * slotPoolsGranule, slotPoolsGranule);
+			}
+			slotPools.counts[sizeClass] = 0;
+		}
+	}
+};
+
+
+static void* SlotPools_alloc(size_t size, size_t align) {
+	uint32_t sizeClass = SlotPools_sizeClass_get(size, align);
+	void* block;
+	if (sizeClass == slotPoolsSizeClasses) {
+		block = ObjectAllocator_alloc(OBJECT_ALLOC_SLOTS, size, align);
+	}
+	else if (slotPools.heads[sizeClass]) {
+		SlotPoolBlock* head = slotPools.heads[sizeClass];
+		slotPools.heads[sizeClass] = head->next;
+		slotPools.counts[sizeClass]--;
+		block = head;
+	}
+	else {
+		block = ObjectAllocator_alloc(OBJECT_ALLOC_SLOTS, (sizeClass + 1) * slotPoolsGranule, slotPoolsGranule);
+	}
+	memset(block, 0, size);
+	return block;
+}
+
+
+static void SlotPools_free(void* block, size_t size, size_t align) {
+	uint32_t sizeClass = SlotPools_sizeClass_get(size, align);
+	if (sizeClass == slotPoolsSizeClasses) {
+		ObjectAllocator_free(OBJECT_ALLOC_SLOTS, block, size, align);
+	}
+	else if (!slotPools.closed && slotPools.counts[sizeClass] < slotPoolsCapacity) {
+		// Flush this thread's pools when it exits
+		static thread_local SlotPoolsExit exit;
+		(void) exit;
+		SlotPoolBlock* head = (SlotPoolBlock*) block;
+		head->next = slotPools.heads[sizeClass];
+		slotPools.heads[sizeClass] = head;
+		slotPools.counts[sizeClass]++;
+	}
+	else {
+		ObjectAllocator_free(OBJECT_ALLOC_SLOTS, block, (sizeClass + 1) * slotPoolsGranule, slotPoolsGranule);
+	}
+}
+
+
+/** Live runtime-allocated slot count of a class, in an open-addressed table keyed by Class pointer so counting never locks. */
+struct ClassSlots {
+	std::atomic<const Class*> cls{NULL};
+	std::atomic<uint64_t> count{0};
+};
+
+static const uint32_t classSlotsShift = 10;
+/** Classes beyond this many aren't counted. */
+static ClassSlots classSlots[1 << classSlotsShift];
+
+
+static ClassSlots* ClassSlots_find(const Class* cls, bool insert) {
+	uint32_t index = uint32_t((uintptr_t(cls) * UINT64_C(0x9E3779B97F4A7C15)) >> (64 - classSlotsShift));
+	for (uint32_t i = 0; i < LENGTHOF(classSlots); i++) {
+		ClassSlots* entry = &classSlots[(index + i) & (LENGTHOF(classSlots) - 1)];
+		const Class* c = entry->cls.load(std::memory_order_acquire);
+		if (c == cls)
+			return entry;
+		if (!c) {
+			if (!insert)
+				return NULL;
+			if (entry->cls.compare_exchange_strong(c, cls, std::memory_order_acq_rel) || c == cls)
+				return entry;
+		}
+	}
+	return NULL;
+}
+
+
+/** Returns a slot allocated by Object_classes_push_alloc() to its pool, unless it's in the object's region. */
+static void Object_slot_free(const Object* self, const Class* cls, void* slot) {
+	if (ClassSlots* entry = ClassSlots_find(cls, false))
+		entry->count.fetch_sub(1, std::memory_order_relaxed);
+	if (Object_region_find(self))
+		return;
+	SlotPools_free(slot, cls->slotSize, SlotPools_align_get(cls));
+}
+
+
+/** Pushes a class with its slot, which the runtime frees in Object_classes_remove() if cls->slotSize is nonzero. */
+static void Object_classes_insert(Object* self, const Class* cls, void* slot) {
+	// Fail silently if class already existed
+	const Schema* schema = Object_schema_require(self);
+	if (schema->slotIndices.find(cls))
+		return;
+	uint32_t slotIndex = schema->slotIndices.size;
+	Object_schemaNode_set(self, SchemaNode_child_findOrCreate(self->schemaNode, SchemaDelta_classPush(cls)));
+	// Build the class push node's schema now rather than lazily, so removing classes never builds a schema
+	Object_schema_require(self);
+	// Store slot inline, or grow the spill array to its exact derived size
+	if (slotIndex < LENGTHOF(self->slotsInline)) {
+		self->slotsInline[slotIndex] = slot;
+	}
+	else {
+		uint32_t spillIndex = slotIndex - LENGTHOF(self->slotsInline);
+		ObjectRegion* region = Object_region_find(self);
+		void** spill = region ? (void**) ObjectRegion_alloc(region, (spillIndex + 1) * sizeof(void*), alignof(void*)) : Object_slotsSpill_alloc(spillIndex + 1);
+		if (spillIndex > 0)
+			memcpy(spill, self->slotsSpill, spillIndex * sizeof(void*));
+		if (!region)
+			Object_slotsSpill_free(self->slotsSpill);
+		self->slotsSpill = spill;
+		self->slotsSpill[spillIndex] = slot;
+	}
+}
+
+
+void Object_classes_push(Object* self, const Class* cls, void* slot) {
+	// The runtime frees the slots of classes with a slot size, so it must also allocate them
+	if (!self || !cls || !slot || cls->slotSize)
+		return;
+	Object_classes_insert(self, cls, slot);
+}
+
+
+void* Object_classes_push_alloc(Object* self, const Class* cls) {
+	if (!self || !cls || !cls->slotSize || (cls->slotAlign & (cls->slotAlign - 1)))
+		return NULL;
+	if (Object_slots_get(self, cls))
+		return NULL;
+	size_t align = SlotPools_align_get(cls);
+	ObjectRegion* region = Object_region_find(self);
+	void* slot;
+	if (region) {
+		slot = ObjectRegion_alloc(region, cls->slotSize, align);
+		memset(slot, 0, cls->slotSize);
+	}
+	else {
+		slot = SlotPools_alloc(cls->slotSize, align);
+	}
+	if (ClassSlots* entry = ClassSlots_find(cls, true))
+		entry->count.fetch_add(1, std::memory_order_relaxed);
+	Object_classes_insert(self, cls, slot);
+	return slot;
+}
+
+
+uint64_t Object_class_slots_count_get(const Class* cls) {
+	if (!cls)
+		return 0;
+	ClassSlots* entry = ClassSlots_find(cls, false);
+	return entry ? entry->count.load(std::memory_order_relaxed) : 0;
+}
+
+
+uint64_t Object_class_slots_bytes_get(const Class* cls) {
+	return Object_class_slots_count_get(cls) * (cls ? cls->slotSize : 0);
+}
+
+
+static inline void* Object_slot_get(const Object* self, uint32_t slotIndex) {
+	if (slotIndex < LENGTHOF(self->slotsInline))
+		return self->slotsInline[slotIndex];
+	uint32_t spillIndex = slotIndex - LENGTHOF(self->slotsInline);
+	return self->slotsSpill[spillIndex];
+}
+
+
+/** Finds a slot from the push history while the object's schema is being built. */
+__attribute__((noinline, cold))
+static void* Object_slots_walk(const Object* self, const Class* cls) {
+	uint32_t slotIndex;
+	if (!SchemaNode_slotIndex_find(self->schemaNode, cls, &slotIndex))
+		return NULL;
+	return Object_slot_get(self, slotIndex);
+}
+
+
+// Don't allow inlining into callers when link-time optimization (LTO) is enabled because it overflows the instruction cache.
+__attribute__((noinline))
+void* Object_slots_get(const Object* self, const Class* cls) {
+	if (!self || !cls)
+		return NULL;
+	const Schema* schema = Object_schema_get(self);
+	if (!schema)
+		return Object_slots_walk(self, cls);
+	const uint32_t* slotIndex = schema->slotIndices.find(cls);
+	if (!slotIndex)
+		return NULL;
+	return Object_slot_get(self, *slotIndex);
+}
+
+
+void Object_classes_remove(Object* self, const Class* cls) {
+	if (!self || !cls)
+		return;
+
+	// Fail silently if the object does not have the class
+	const Schema* schema = Object_classesSchema_get(self);
+	if (!schema)
+		return;
+	const uint32_t* slotIndex = schema->slotIndices.find(cls);
+	if (!slotIndex)
+		return;
+	uint32_t clsIndex = *slotIndex;
+
+	// Remove classes from top down to cls (inclusive)
+	const SchemaNode* n = self->schemaNode;
+	for (uint32_t i = schema->slotIndices.size; i > clsIndex; i--) {
+		const Class* c = schema->classes[i - 1];
+		// Revert the method pushes above the class, landing on the node that pushed the class
+		while (n->delta.type != SchemaDelta::CLASS || n->delta.cls != c)
+			n = n->parent;
+		SchemaNode_acquire(n);
+		Object_schemaNode_set(self, n);
+		void* slot = c->slotSize ? Object_slot_get(self, i - 1) : NULL;
+		if (c->free)
+			c->free(self);
+		if (slot)
+			Object_slot_free(self, c, slot);
+		// Set parent class
+		n = n->parent;
+		SchemaNode_acquire(n);
+		Object_schemaNode_set(self, n);
+	}
+}
+
+
+/** Returns the object's schema if it is already built, or NULL, without building or claiming it. */
+static const Schema* Object_schemaBuilt_get(const Object* self) {
+	const Schema* schema = self->schema.load(std::memory_order_acquire);
+	if (schema)
+		return schema;
+	return self->schemaNode->schema.load(std::memory_order_acquire);
+}
+
+
+uint64_t Object_classes_count_get(const Object* self) {
+	if (!self)
+		return 0;
+	// Introspection walks the node chain rather than building a schema, so it is safe on real-time threads
+	const Schema* schema = Object_schemaBuilt_get(self);
+	if (!schema)
+		return SchemaNode_classes_count(self->schemaNode);
+	return schema->slotIndices.size;
+}
+
+
+const Class* Object_classes_get(const Object* self, uint64_t index) {
+	if (!self)
+		return NULL;
+	const Schema* schema = Object_schemaBuilt_get(self);
+	if (!schema)
+		return SchemaNode_class_get(self->schemaNode, index);
+	if (index >= schema->slotIndices.size)
+		return NULL;
+	return schema->classes[index];
+}
+
+
+void Object_methods_push(Object* self, void* dispatcher, void* method) {
+	if (!self || !dispatcher || !method)
+		return;
+	// Find and return existing SchemaNode with the exact delta
+	SchemaDelta delta = SchemaDelta_methodPush(dispatcher, method);
+	SchemaNode* child = SchemaNode_child_find(self->schemaNode, delta);
+	if (child) {
+		Object_schemaNode_set(self, child);
+		return;
+	}
+	// Check if the dispatcher already has a method
+	if (SchemaNode_method_find(self->schemaNode, dispatcher)) {
+		// Don't allow overriding with a method that was already pushed
+		if (SchemaNode_dispatcher_find(self->schemaNode, method))
+			return;
+	}
+	Object_schemaNode_set(self, SchemaNode_child_findOrCreate(self->schemaNode, delta));
+}
+
+
+__attribute__((noinline))
+void* Object_methods_get(const Object* self, void* dispatcher) {
+	if (!self || !dispatcher)
+		return NULL;
+	const Schema* schema = Object_schema_get(self);
+	if (!schema)
+		return SchemaNode_method_find(self->schemaNode, dispatcher);
+	void* const* method = schema->methods.find(dispatcher);
+	if (!method)
+		return NULL;
+	return *method;
+}
+
+
+__attribute__((noinline))
+void* Object_supermethods_get(const Object* self, void* method) {
+	if (!self || !method)
+		return NULL;
+	const Schema* schema = Object_schema_get(self);
+	if (!schema)
+		return SchemaNode_supermethod_find(self->schemaNode, method);
+	void* const* supermethod = schema->supermethods.find(method);
+	if (!supermethod)
+		return NULL;
+	return *supermethod;
+}
+
+
+bool Object_allocator_set(ObjectAllocCategory category, const ObjectAllocator* allocator) {
+	if (unsigned(category) >= OBJECT_ALLOC_CATEGORIES)
+		return false;
+	if (allocator && (!allocator->alloc || !allocator->free))
+		return false;
+	ObjectAllocCategoryState& state = objectAllocCategories[category];
+	if (ObjectAllocator_bytes_get(category) != 0)
+		return false;
+	state.allocator = allocator ? *allocator : ObjectAllocator{ObjectAllocator_defaultAlloc, ObjectAllocator_defaultFree, NULL};
+	return true;
+}
+
+
+uint64_t Object_allocs_count_get(ObjectAllocCategory category) {
+	if (unsigned(category) >= OBJECT_ALLOC_CATEGORIES)
+		return 0;
+	return ObjectAllocator_count_get(category);
+}
+
+
+uint64_t Object_allocs_bytes_get(ObjectAllocCategory category) {
+	if (unsigned(category) >= OBJECT_ALLOC_CATEGORIES)
+		return 0;
+	return ObjectAllocator_bytes_get(category);
+}
+
+
+char* Object_inspect(const Object* self) {
+	if (!self)
+		return NULL;
+
+	size_t capacity = 1024;
+	size_t pos = 0;
+	char* s = (char*) malloc(capacity);
+	if (!s)
+		return NULL;
+
+	uint32_t strong = Object_refs_get(self);
+	uint32_t weak = Object_weak_refs_get(self);
+	int size = snprintf(s + pos, capacity - pos, "Object(%p)[%u,%u]:", self, strong, weak);
+	if (size < 0) {
+		free(s);
+		return NULL;
+	}
+	pos += size;
+
+	const Schema* schema = Object_schema_require(self);
+	for (uint32_t i = 0; i < schema->slotIndices.size; i++) {
+		const Class* cls = schema->classes[i];
+		void* slot = Object_slots_get(self, cls);
+		size = snprintf(s + pos, capacity - pos, " %s(%p)", cls->name, slot);
+		if (size < 0)
+			break;
+		pos += size;
+		if (pos >= capacity) {
+			pos = capacity - 1;
+			break;
+		}
+	}
+	s = (char*) realloc(s, pos + 1);
+	return s;
+}
+
+
+void Object_schema_prepare(const Object* self) {
+	Object_schemas_prepare(&self, 1, 0);
+}
+
+
+void Object_schemas_prepare(const Object* const* objects, uint64_t count, uint32_t depth) {
+	if (!objects)
+		return;
+	for (uint64_t i = 0; i < count; i++) {
+		const Object* self = objects[i];
+		if (!self)
+			continue;
+		Object_schema_require(self);
+		if (depth > 0) {
+			SchemaReadGuard guard;
+			SchemaNode_descendants_build(self->schemaNode, depth);
+		}
+	}
+}
+
+
+char* Object_schemas_manifest_export() {
+	std::string manifest = "# Object schema manifest\n";
+	{
+		SchemaReadGuard guard;
+		std::string path;
+		SchemaNode_manifest_export(rootNode_get(), &path, manifest);
+	}
+	char* s = (char*) malloc(manifest.size() + 1);
+	if (!s)
+		return NULL;
+	memcpy(s, manifest.c_str(), manifest.size() + 1);
+	return s;
+}
+
+
+/** Creates and builds the nodes along a manifest line's path.
+Returns false if a delta can't be resolved or isn't a valid push, leaving the nodes before it built.
+*/
+static bool Object_schemas_manifest_replayLine(const std::string& line) {
+	const SchemaNode* node = rootNode_get();
+	bool valid = true;
+	size_t pos = 0;
+	while (pos < line.size()) {
+		size_t end = line.find(' ', pos);
+		if (end == std::string::npos)
+			end = line.size();
+		SchemaDelta delta;
+		if (end > pos) {
+			// Reject deltas that Object_classes_push() and Object_methods_push() would refuse
+			uint32_t slotIndex;
+			if (!SchemaDelta_manifest_read(line.substr(pos, end - pos), delta)
+				|| (delta.type == SchemaDelta::CLASS && SchemaNode_slotIndex_find(node, delta.cls, &slotIndex))
+				|| (delta.type == SchemaDelta::METHOD && SchemaNode_dispatcher_find(node, delta.method))) {
+				valid = false;
+				break;
+			}
+			const SchemaNode* child = SchemaNode_child_findOrCreate(node, delta);
+			SchemaNode_schema_get(child);
+			// The child keeps its parent from being reclaimed
+			SchemaNode_release(node);
+			node = child;
+		}
+		pos = end + 1;
+	}
+	SchemaNode_release(node);
+	return valid;
+}
+
+
+uint64_t Object_schemas_manifest_replay(const char* manifest) {
+	if (!manifest)
+		return 0;
+	uint64_t count = 0;
+	const char* s = manifest;
+	while (*s) {
+		const char* end = strchr(s, '\n');
+		if (!end)
+			end = s + strlen(s);
+		std::string line(s, end);
+		if (!line.empty() && line[0] != '#' && Object_schemas_manifest_replayLine(line))
+			count++;
+		s = *end ? end + 1 : end;
+	}
+	return count;
+}
+
+
+void Object_thread_realtime_set(bool realtime) {
+	threadRealtime = realtime;
+}
+
+
+bool Object_thread_realtime_get() {
+	return threadRealtime;
+}
+
+
+uint64_t Object_realtimeBuilds_count_get() {
+	return realtimeBuilds.load(std::memory_order_relaxed);
+}
+
+
+void Object_realtimeBuilds_abort_set(bool enabled) {
+	realtimeBuildsAbort.store(enabled, std::memory_order_relaxed);
+}
+
+
+void Object_schemas_async_set(bool async) {
+	SchemaBuilder_enabled_set(async);
+}
+
+
+bool Object_schemas_async_get() {
+	return schemaBuilder.enabled.load(std::memory_order_relaxed);
+}
+
+
+void Object_thread_unref_deferred_set(bool deferred) {
+	threadUnrefDeferred = deferred;
+}
+
+
+bool Object_thread_unref_deferred_get() {
+	return threadUnrefDeferred;
+}
+
+
+void Object_reclaimer_start() {
+	std::lock_guard<std::mutex> lock(deferredUnrefs.mutex);
+	if (deferredUnrefs.thread)
+		return;
+	deferredUnrefs.stopping.store(false, std::memory_order_relaxed);
+	deferredUnrefs.thread = new std::thread(DeferredUnrefs_run);
+}
+
+
+void Object_reclaimer_stop() {
+	std::lock_guard<std::mutex> lock(deferredUnrefs.mutex);
+	if (!deferredUnrefs.thread)
+		return;
+	deferredUnrefs.stopping.store(true, std::memory_order_release);
+	deferredUnrefs.thread->join();
+	delete deferredUnrefs.thread;
+	deferredUnrefs.thread = NULL;
+}
+
+
+uint64_t Object_deferred_reclaim() {
+	return DeferredUnrefs_reclaim();
+}
+
+
+uint64_t Object_deferred_depth_get() {
+	return deferredUnrefs.queue.size_get();
+}
+
+
+uint64_t Object_deferred_reclaimed_get() {
+	return deferredUnrefs.reclaimed.load(std::memory_order_relaxed);
+}
+
+
+uint64_t Object_deferred_overflows_get() {
+	return deferredUnrefs.overflows.load(std::memory_order_relaxed);
+}
+
+
+uint64_t Object_deferred_latencyTotal_get() {
+	return deferredUnrefs.latencyTotal.load(std::memory_order_relaxed);
+}
+
+
+uint64_t Object_deferred_latencyMax_get() {
+	return deferredUnrefs.latencyMax.load(std::memory_order_relaxed);
+}
+
+
+void Object_unref_parallel(const Object* const* roots, uint64_t count) {
+	uint32_t threadsCount = parallelThreads.load(std::memory_order_relaxed);
+	if (threadsCount == 0)
+		threadsCount = std::max(std::thread::hardware_concurrency(), 1u);
+	// Releasing from a free() function, or without other threads, frees serially
+	if (threadsCount == 1 || threadFrees.freeing || threadFrees.worker) {
+		Object_unref_array(roots, count);
+		return;
+	}
+
+	std::lock_guard<std::mutex> call(parallelPool.callMutex);
+	{
+		std::lock_guard<std::mutex> lock(parallelPool.mutex);
+		while (parallelPool.threads.size() + 1 < threadsCount)
+			parallelPool.threads.emplace_back(ParallelPool_run, (uint32_t) parallelPool.threads.size() + 1);
+	}
+
+	// Free on the workers rather than queueing for the reclaimer
+	bool deferred = threadUnrefDeferred;
+	threadUnrefDeferred = false;
+
+	ParallelTeardown teardown;
+	teardown.helpers.store(threadsCount - 1, std::memory_order_relaxed);
+	RuntimeVector<ParallelWorker> workers(threadsCount);
+	teardown.workers = workers.data();
+	teardown.workersCount = threadsCount;
+	for (ParallelWorker& worker : workers)
+		worker.teardown = &teardown;
+
+	// Deal the released roots out to the workers
+	threadFrees.worker = &workers[0];
+	for (uint64_t i = 0; i < count; i++) {
+		if (!roots[i])
+			continue;
+		threadFrees.worker = &workers[i % threadsCount];
+		if (Object_refs_decrease(roots[i], 1))
+			Object_final_unref(roots[i]);
+	}
+	threadFrees.worker = NULL;
+
+	{
+		std::lock_guard<std::mutex> lock(parallelPool.mutex);
+		parallelPool.teardown = &teardown;
+		parallelPool.generation++;
+	}
+	parallelPool.wake.notify_all();
+	ParallelWorker_run(&workers[0], true);
+	while (teardown.helpers.load(std::memory_order_acquire) != 0)
+		std::this_thread::yield();
+	{
+		std::lock_guard<std::mutex> lock(parallelPool.mutex);
+		parallelPool.teardown = NULL;
+	}
+
+	// Objects released by serial free() functions are freed serially too
+	for (const Object* self : teardown.serial)
+		Object_final_run(self);
+	threadUnrefDeferred = deferred;
+}
+
+
+void Object_parallel_threads_set(uint32_t threads) {
+	parallelThreads.store(threads, std::memory_order_relaxed);
+}
+
+
+uint32_t Object_parallel_threads_get() {
+	return parallelThreads.load(std::memory_order_relaxed);
+}
+
+
+void Object_thread_free_budget_set(uint64_t nanoseconds) {
+	threadFrees.budget = nanoseconds;
+}
+
+
+uint64_t Object_thread_free_budget_get() {
+	return threadFrees.budget;
+}
+
+
+uint64_t Object_thread_frees_continue() {
+	ThreadFrees& frees = threadFrees;
+	// Called from a free() function, so the outer release will free them
+	if (frees.freeing)
+		return frees.pendingCount;
+	std::chrono::steady_clock::time_point deadline;
+	if (frees.budget > 0)
+		deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(frees.budget);
+	return ThreadFrees_drain(frees, deadline);
+}
+
+
+uint64_t Object_thread_frees_pending_get() {
+	return threadFrees.pendingCount;
+}
+
+
+void Object_rcu_read_lock() {
+	RcuThread& thread = rcuThread;
+	if (thread.depth++ > 0)
+		return;
+	if (!thread.reader)
+		thread.reader = RcuReader_acquire();
+	// Sequentially consistent, so a writer that doesn't see this epoch has already unpublished anything this thread will read
+	thread.reader->epoch.exchange(rcu.epoch.load());
+}
+
+
+void Object_rcu_read_unlock() {
+	RcuThread& thread = rcuThread;
+	if (thread.depth == 0)
+		return;
+	if (--thread.depth > 0)
+		return;
+	thread.reader->epoch.store(0, std::memory_order_release);
+}
+
+
+/** Views a published variable as the std::atomic that C++ callers such as RcuRefT store. */
+static std::atomic<Object*>* Rcu_slot_get(Object* const* slot) {
+	static_assert(sizeof(std::atomic<Object*>) == sizeof(Object*) && std::atomic<Object*>::is_always_lock_free, "published variables must be plain pointers");
+	return reinterpret_cast<std::atomic<Object*>*>(const_cast<Object**>(slot));
+}
+
+
+Object* Object_rcu_read(Object* const* slot) {
+	if (!slot)
+		return NULL;
+	return Rcu_slot_get(slot)->load();
+}
+
+
+void Object_rcu_publish(Object** slot, Object* object) {
+	if (!slot)
+		return;
+	Object_rcu_retire(Rcu_slot_get(slot)->exchange(object));
+}
+
+
+void Object_rcu_retire(const Object* object) {
+	if (!object)
+		return;
+	// Readers that enter at the new epoch or later can't read the object
+	uint64_t epoch = rcu.epoch.fetch_add(1) + 1;
+	{
+		std::lock_guard<std::mutex> lock(rcu.retiredMutex);
+		rcu.retired.push_back({object, epoch});
+		rcu.retiredCount.store(rcu.retired.size(), std::memory_order_relaxed);
+	}
+	Rcu_reclaim();
+}
+
+
+uint64_t Object_rcu_reclaim() {
+	return Rcu_reclaim();
+}
+
+
+void Object_rcu_synchronize() {
+	// Waiting inside a read-side section would never finish
+	if (rcuThread.depth > 0)
+		return;
+	while (Rcu_reclaim() > 0)
+		std::this_thread::yield();
+}
+
+
+void Object_recycle_capacity_set(uint32_t capacity) {
+	Object* freed = NULL;
+	{
+		std::lock_guard<std::mutex> lock(recyclePools.mutex);
+		recyclePools.capacity.store(capacity, std::memory_order_relaxed);
+		for (RecyclePool& pool : recyclePools.pools) {
+			if (!pool.cls.load(std::memory_order_acquire))
+				continue;
+			if (capacity == 0) {
+				// Forget the registered node, so it can be reclaimed
+				const SchemaNode* node = pool.node.exchange(NULL, std::memory_order_relaxed);
+				if (node)
+					SchemaNode_release(node);
+			}
+			RecyclePool_trim(&pool, capacity, freed);
+		}
+	}
+	// Free them outside the lock, since free() functions may create objects
+	RecyclePool_free(freed);
+}
+
+
+uint32_t Object_recycle_capacity_get() {
+	return recyclePools.capacity.load(std::memory_order_relaxed);
+}
+
+
+Object* Object_recycled_take(const Class* cls) {
+	if (!cls || recyclePools.capacity.load(std::memory_order_relaxed) == 0)
+		return NULL;
+	// Objects created while a region is set must come from the region
+	if (threadRegion)
+		return NULL;
+	RecyclePool* pool = RecyclePool_find(cls, false);
+	if (!pool || !pool->head.load(std::memory_order_relaxed))
+		return NULL;
+	// Take the whole list, so no other taker can unlink the same object, and push the rest back
+	Object* self = pool->head.exchange(NULL, std::memory_order_acquire);
+	if (!self)
+		return NULL;
+	Object* rest = RecyclePool_unlink(self);
+	if (rest) {
+		Object* head = NULL;
+		if (!pool->head.compare_exchange_strong(head, rest, std::memory_order_release, std::memory_order_relaxed)) {
+			Object* last = rest;
+			while (Object* next = RecyclePool_next_get(last))
+				last = next;
+			RecyclePool_push(pool, rest, last);
+		}
+	}
+	pool->count.fetch_sub(1, std::memory_order_relaxed);
+	self = Object_recycled_revive(self);
+	// An object kept while its class was registered with another node isn't what _create() returns now
+	if (self->schemaNode != pool->node.load(std::memory_order_relaxed)) {
+		Object_unref(self);
+		return NULL;
+	}
+	recyclePools.reused.fetch_add(1, std::memory_order_relaxed);
+	return self;
+}
+
+
+void Object_recycle_register(const Class* cls, const Object* self) {
+	if (!cls || !self || recyclePools.capacity.load(std::memory_order_relaxed) == 0)
+		return;
+	RecyclePool* pool = RecyclePool_find(cls, false);
+	if (pool && pool->node.load(std::memory_order_relaxed) == self->schemaNode)
+		return;
+	Object* freed = NULL;
+	{
+		std::lock_guard<std::mutex> lock(recyclePools.mutex);
+		if (recyclePools.capacity.load(std::memory_order_relaxed) == 0)
+			return;
+		pool = RecyclePool_find(cls, true);
+		if (!pool || pool->node.load(std::memory_order_relaxed) == self->schemaNode)
+			return;
+		// The object holds its node, so acquiring it succeeds
+		SchemaNode_acquire(self->schemaNode);
+		const SchemaNode* previous = pool->node.exchange(self->schemaNode, std::memory_order_relaxed);
+		// The class's _create() function now returns objects of another node, so objects kept for the previous one won't be taken
+		if (previous) {
+			SchemaNode_release(previous);
+			RecyclePool_trim(pool, recyclePools.capacity.load(std::memory_order_relaxed), freed);
+		}
+	}
+	RecyclePool_free(freed);
+}
+
+
+uint64_t Object_recycled_count_get() {
+	return recyclePools.reused.load(std::memory_order_relaxed);
+}
+
+
+size_t Object_size_get() {
+	return sizeof(Object);
+}
+
+
+size_t Object_align_get() {
+	return alignof(Object);
+}
+
+
+Object* Object_init_in(void* buffer) {
+	if (!buffer || (uintptr_t(buffer) & (alignof(Object) - 1)))
+		return NULL;
+	Object* self = Object_storage_construct(buffer, Object::refsExternal);
+	alive.fetch_add(1, std::memory_order_relaxed);
+	return self;
+}
+
+
+void Object_deinit(Object* self) {
+	if (!self)
+		return;
+	if (!(self->refs.load(std::memory_order_relaxed) & Object::refsExternal))
+		return;
+	Object_thread_refs_merge();
+	Object_storage_release(&self, 1, "storage");
+}
+
+
+ObjectRegion* Object_region_create() {
+	return ObjectAllocator_new<ObjectRegion>(OBJECT_ALLOC_RUNTIME);
+}
+
+
+void Object_region_destroy(ObjectRegion* region) {
+	if (!region)
+		return;
+	if (threadRegion == region)
+		threadRegion = NULL;
+	Object_thread_refs_merge();
+	Object_storage_release(region->objects.data(), region->objects.size(), "region");
+
+	for (RegionChunk* chunk = region->chunks; chunk;) {
+		RegionChunk* next = chunk->next;
+		ObjectAllocator_free(OBJECT_ALLOC_RUNTIME, chunk, regionChunkSize, regionChunkSize);
+		chunk = next;
+	}
+	for (const RegionLarge& large : region->large)
+		ObjectAllocator_free(OBJECT_ALLOC_RUNTIME, large.block, large.size, large.align);
+	ObjectAllocator_delete(OBJECT_ALLOC_RUNTIME, region);
+}
+
+
+void* Object_region_alloc(ObjectRegion* region, size_t size) {
+	if (!region)
+		return NULL;
+	return ObjectRegion_alloc(region, size, alignof(std::max_align_t));
+}
+
+
+ObjectRegion* Object_region_get(const Object* self) {
+	if (!self)
+		return NULL;
+	return Object_region_find(self);
+}
+
+
+void Object_thread_region_set(ObjectRegion* region) {
+	threadRegion = region;
+}
+
+
+ObjectRegion* Object_thread_region_get() {
+	return threadRegion;
+}
+
+
+uint64_t Object_alive_get() {
+	return alive.load(std::memory_order_relaxed);
+}
+
+
+uint64_t Object_schemaNodes_count_get() {
+	SchemaReadGuard guard;
+	return SchemaNode_count_get(rootNode_get());
+}
+
+
+uint64_t Object_schemaNodes_reclaim() {
+	return SchemaNode_reclaim(rootNode_get());
+}
+
+
+uint32_t Object_schemaNodes_retention_get() {
+	return schemaReclaimer.retention.load(std::memory_order_relaxed);
+}
+
+
+void Object_schemaNodes_retention_set(uint32_t passes) {
+	schemaReclaimer.retention.store(passes, std::memory_order_relaxed);
+}
+
+
+uint64_t Object_schemaNodes_reclaimedBytes_get() {
+	return schemaReclaimer.reclaimedBytes.load(std::memory_order_relaxed);
+}
+
+
+uint64_t Object_schemas_count_get() {
+	return schemaSet.count.load(std::memory_order_relaxed);
 }
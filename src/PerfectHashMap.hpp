@@ -2,6 +2,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <algorithm>
+#include "Allocator.hpp"
 
 
 /** Hash map with a perfect hash function, so every lookup reads exactly one table entry.
@@ -37,14 +38,38 @@ struct PerfectHashMap {
 	uint8_t positionShift = 0;
 	/** Number of occupied entries in the table. */
 	uint32_t size = 0;
+	/** Whether seeds and table live in storage owned by the caller or a scratch arena, so the map doesn't free them. */
+	bool external = false;
+	/** Arena that build() allocates the seeds, table, and scratch arrays from, or NULL for the runtime's allocator. */
+	ScratchArena* scratch = NULL;
 
 	PerfectHashMap() {
 		build(NULL, 0);
 	}
 
+	/** Builds a map whose arrays are allocated from a scratch arena, and stay valid until the arena's next reset(). */
+	PerfectHashMap(const Entry* entries, uint32_t count, ScratchArena* scratch) : scratch(scratch) {
+		build(entries, count);
+	}
+
+	/** Copies another map's seeds and table into caller-owned storage, and advances `storage` by other.bytes_get().
+	storage must be aligned to 8 bytes and outlive the map.
+	*/
+	PerfectHashMap(const PerfectHashMap& other, char*& storage) : singleSeed(other.singleSeed), bucketShift(other.bucketShift), positionShift(other.positionShift), size(other.size), external(true) {
+		size_t tableLength = size_t(1) << (64 - positionShift);
+		table = (Entry*) storage;
+		std::copy(other.table, other.table + tableLength, table);
+		storage += tableLength * sizeof(Entry);
+		if (other.seeds) {
+			size_t bucketCount = size_t(1) << (64 - bucketShift);
+			seeds = (uint64_t*) storage;
+			std::copy(other.seeds, other.seeds + bucketCount, seeds);
+			storage += bucketCount * sizeof(uint64_t);
+		}
+	}
+
 	~PerfectHashMap() {
-		delete[] seeds;
-		delete[] table;
+		tables_free();
 	}
 
 	PerfectHashMap(const PerfectHashMap&) = delete;
@@ -66,14 +91,22 @@ struct PerfectHashMap {
 		return &entry.value;
 	}
 
+	/** Returns the number of bytes allocated for the seeds and table. */
+	size_t bytes_get() const {
+		size_t bytes = (size_t(1) << (64 - positionShift)) * sizeof(Entry);
+		if (seeds)
+			bytes += (size_t(1) << (64 - bucketShift)) * sizeof(uint64_t);
+		return bytes;
+	}
+
 	/** Builds a perfect hash table from an array of entries, replacing the previous contents.
 	Keys must be distinct, nonzero, and convertible to uint64_t.
 	Not thread-safe with lookups on the same map.
 	Deterministic, so the same entries always build the same table.
 	*/
 	void build(const Entry* entries, uint32_t count) {
-		delete[] seeds;
-		delete[] table;
+		tables_free();
+		external = scratch != NULL;
 		seeds = NULL;
 		table = NULL;
 		size = count;
@@ -81,7 +114,7 @@ struct PerfectHashMap {
 		bucketShift = 0;
 
 		// Scratch array for tentative placements
-		uint64_t* positions = new uint64_t[count];
+		uint64_t* positions = array_new<uint64_t>(count);
 		uint64_t seedState = 0;
 
 		// Search for a whole-map seed, so lookups skip the bucket step
@@ -91,14 +124,14 @@ struct PerfectHashMap {
 			while (capacity < 2 * count || uint64_t(count) * count > 16 * capacity)
 				capacity *= 2;
 			positionShift = 64 - __builtin_ctz(capacity);
-			table = new Entry[capacity]();
+			table = array_new<Entry>(capacity);
 
 			singleSeed = entries_place(entries, count, positions, seedState, singleSeedTrialLimit);
 			if (singleSeed) {
-				delete[] positions;
+				array_delete(positions, count);
 				return;
 			}
-			delete[] table;
+			array_delete(table, capacity);
 			table = NULL;
 		}
 
@@ -115,18 +148,18 @@ struct PerfectHashMap {
 		positionShift = 64 - __builtin_ctzll(capacity);
 
 		// Count the keys in each bucket
-		uint32_t* bucketSizes = new uint32_t[bucketCount]();
+		uint32_t* bucketSizes = array_new<uint32_t>(bucketCount);
 		for (uint32_t i = 0; i < count; i++)
 			bucketSizes[hash(entries[i].key) >> bucketShift]++;
 
 		// Group entries by bucket, decrementing each bucket's offset from its end to its start
-		uint32_t* bucketOffsets = new uint32_t[bucketCount];
+		uint32_t* bucketOffsets = array_new<uint32_t>(bucketCount);
 		uint32_t offset = 0;
 		for (uint32_t b = 0; b < bucketCount; b++) {
 			offset += bucketSizes[b];
 			bucketOffsets[b] = offset;
 		}
-		Entry* groupedEntries = new Entry[count];
+		Entry* groupedEntries = array_new<Entry>(count);
 		for (uint32_t i = 0; i < count; i++) {
 			uint32_t b = hash(entries[i].key) >> bucketShift;
 			groupedEntries[--bucketOffsets[b]] = entries[i];
@@ -134,7 +167,7 @@ struct PerfectHashMap {
 		// bucketOffsets[b] is now the start of bucket b in groupedEntries
 
 		// Order buckets from largest to smallest, so the biggest buckets are placed while the table is emptiest
-		uint32_t* bucketOrder = new uint32_t[bucketCount];
+		uint32_t* bucketOrder = array_new<uint32_t>(bucketCount);
 		for (uint32_t b = 0; b < bucketCount; b++)
 			bucketOrder[b] = b;
 		std::sort(bucketOrder, bucketOrder + bucketCount, [&](uint32_t a, uint32_t b) {
@@ -145,8 +178,8 @@ struct PerfectHashMap {
 
 		// Retry with a doubled table if any bucket exhausts its seed trials, which is vanishingly rare with distinct keys
 		while (true) {
-			seeds = new uint64_t[bucketCount]();
-			table = new Entry[capacity]();
+			seeds = array_new<uint64_t>(bucketCount);
+			table = array_new<Entry>(capacity);
 
 			bool built = true;
 			for (uint32_t i = 0; i < bucketCount; i++) {
@@ -164,17 +197,47 @@ struct PerfectHashMap {
 			if (built)
 				break;
 
-			delete[] seeds;
-			delete[] table;
+			array_delete(seeds, bucketCount);
+			array_delete(table, capacity);
 			capacity *= 2;
 			positionShift--;
 		}
 
-		delete[] bucketOrder;
-		delete[] groupedEntries;
-		delete[] bucketOffsets;
-		delete[] bucketSizes;
-		delete[] positions;
+		array_delete(bucketOrder, bucketCount);
+		array_delete(groupedEntries, count);
+		array_delete(bucketOffsets, bucketCount);
+		array_delete(bucketSizes, bucketCount);
+		array_delete(positions, count);
+	}
+
+	/** Tables and scratch arrays are schema memory, allocated by the runtime's allocator unless the map has a scratch arena. */
+	template <typename T>
+	T* array_new(size_t length) {
+		if (!scratch)
+			return ObjectAllocator_newArray<T>(OBJECT_ALLOC_SCHEMAS, length);
+		if (length == 0)
+			return NULL;
+		T* p = (T*) scratch->alloc(length * sizeof(T), alignof(T));
+		for (size_t i = 0; i < length; i++)
+			new (&p[i]) T();
+		return p;
+	}
+
+	/** Arena arrays are released by the arena's reset(). */
+	template <typename T>
+	void array_delete(T* p, size_t length) {
+		if (!scratch)
+			ObjectAllocator_deleteArray(OBJECT_ALLOC_SCHEMAS, p, length);
+	}
+
+	/** Frees the seeds and table unless they live in caller-owned storage. */
+	void tables_free() {
+		if (external)
+			return;
+		if (seeds)
+			array_delete(seeds, size_t(1) << (64 - bucketShift));
+		if (table)
+			array_delete(table, size_t(1) << (64 - positionShift));
 	}
 
 	/** Searches up to maxTrials seeds for one that places all of the given entries into distinct empty table entries, and commits the placement.
@@ -3,9 +3,21 @@
 #include <cstdint>
 #include <atomic>
 #include <vector>
+#include <mutex>
+#include <thread>
+#include <new>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <cstring>
+#if !defined _WIN32
+#include <dlfcn.h>
+#endif
 
 #include <Object/Object.h>
+#include "Allocator.hpp"
 #include "PerfectHashMap.hpp"
+#include "BoundedQueue.hpp"
 
 
 struct SchemaDelta {
@@ -56,6 +68,14 @@ static inline bool SchemaDelta_equal_is(const SchemaDelta& a, const SchemaDelta&
 }
 
 
+typedef PerfectHashMap<void*, void*>::Entry SchemaMethodEntry;
+typedef PerfectHashMap<const Class*, uint32_t>::Entry SchemaSlotEntry;
+
+
+/** Resolved method tables and slot indices of a SchemaNode.
+Schemas are interned by content in the global SchemaSet, so nodes reached by different push orders share one Schema if their classes and method tables are equal.
+A Schema pointer therefore identifies an object's type, and can be used as a key for inline caches.
+*/
 struct Schema {
 	// dispatcher method pointer -> direct method pointer
 	PerfectHashMap<void*, void*> methods;
@@ -63,20 +83,368 @@ struct Schema {
 	PerfectHashMap<void*, void*> supermethods;
 	// class -> index into Object's slots
 	PerfectHashMap<const Class*, uint32_t> slotIndices;
+	/** Classes in push order, indexed by slot index.
+	Length is `slotIndices.size`.
+	*/
+	const Class** classes = NULL;
+	/** Content hash used by SchemaSet. */
+	uint64_t hash = 0;
+	/** Next schema in the SchemaSet bucket. */
+	std::atomic<Schema*> next{NULL};
+	/** Number of SchemaNodes using this schema, or `dead` once it is unlinked for reclamation. */
+	std::atomic<uint32_t> nodes{0};
+
+	static const uint32_t dead = UINT32_MAX;
+
+	/** Copies the tables of maps built by the caller into the storage following the Schema in its block. */
+	Schema(const PerfectHashMap<void*, void*>& methods, const PerfectHashMap<void*, void*>& supermethods, const PerfectHashMap<const Class*, uint32_t>& slotIndices, char* storage) :
+		methods(methods, storage),
+		supermethods(supermethods, storage),
+		slotIndices(slotIndices, storage) {
+		classes = (const Class**) storage;
+	}
+
+	/** Returns the size of the schema's block. */
+	size_t bytes_get() const {
+		return sizeof(Schema) + methods.bytes_get() + supermethods.bytes_get() + slotIndices.bytes_get() + slotIndices.size * sizeof(const Class*);
+	}
 };
 
 
+/** Memory for the scratch maps of Schema_create(), reused by each schema the thread builds. */
+static thread_local ScratchArena schemaScratch{OBJECT_ALLOC_SCHEMAS};
+
+
+/** Allocates a schema in a single block holding the header, seeds, tables, and class list, so lookups touch one contiguous allocation.
+*/
+static Schema* Schema_create(const SchemaVector<SchemaSlotEntry>& slotIndexEntries, const SchemaVector<SchemaMethodEntry>& methodEntries, const SchemaVector<SchemaMethodEntry>& supermethodEntries) {
+	// Build the tables in scratch maps to learn their sizes.
+	// Once the thread's arena has grown to fit, the schema's block is the only allocation.
+	schemaScratch.reset();
+	PerfectHashMap<void*, void*> methods(methodEntries.data(), methodEntries.size(), &schemaScratch);
+	PerfectHashMap<void*, void*> supermethods(supermethodEntries.data(), supermethodEntries.size(), &schemaScratch);
+	PerfectHashMap<const Class*, uint32_t> slotIndices(slotIndexEntries.data(), slotIndexEntries.size(), &schemaScratch);
+
+	size_t size = sizeof(Schema) + methods.bytes_get() + supermethods.bytes_get() + slotIndices.bytes_get() + slotIndices.size * sizeof(const Class*);
+	char* block = (char*) ObjectAllocator_alloc(OBJECT_ALLOC_SCHEMAS, size, alignof(Schema));
+	Schema* schema = new (block) Schema(methods, supermethods, slotIndices, block + sizeof(Schema));
+	for (const SchemaSlotEntry& entry : slotIndexEntries)
+		schema->classes[entry.value] = entry.key;
+	return schema;
+}
+
+
+static void Schema_destroy(Schema* schema) {
+	size_t size = schema->bytes_get();
+	schema->~Schema();
+	ObjectAllocator_free(OBJECT_ALLOC_SCHEMAS, (void*) schema, size, alignof(Schema));
+}
+
+
+/** State for reclaiming SchemaNodes and Schemas that no object uses.
+Lock-free readers of children lists and SchemaSet buckets enter a SchemaReadGuard.
+A reclaim pass unlinks unused nodes and schemas, flips the epoch, and waits for readers of the previous epoch to leave before deleting them.
+*/
+struct SchemaReclaimer {
+	std::atomic<uint64_t> epoch{0};
+	/** Number of readers in each epoch parity. */
+	std::atomic<uint32_t> readers[2] = {};
+	/** Serializes reclaim passes. Readers never take it. */
+	std::mutex mutex;
+	/** Consecutive passes a node must be found unused before it is reclaimed. */
+	std::atomic<uint32_t> retention{1};
+	std::atomic<uint64_t> reclaimedBytes{0};
+};
+
+static SchemaReclaimer schemaReclaimer;
+
+
+/** Scope in which SchemaNodes reached through children lists and Schemas reached through SchemaSet buckets are not deleted. */
+struct SchemaReadGuard {
+	uint32_t parity;
+
+	SchemaReadGuard() {
+		while (true) {
+			parity = schemaReclaimer.epoch.load() & 1;
+			schemaReclaimer.readers[parity].fetch_add(1);
+			// Retry if a reclaim pass flipped the epoch before this reader was counted
+			if ((schemaReclaimer.epoch.load() & 1) == parity)
+				break;
+			schemaReclaimer.readers[parity].fetch_sub(1);
+		}
+	}
+
+	~SchemaReadGuard() {
+		schemaReclaimer.readers[parity].fetch_sub(1);
+	}
+
+	SchemaReadGuard(const SchemaReadGuard&) = delete;
+	SchemaReadGuard& operator=(const SchemaReadGuard&) = delete;
+};
+
+
+/** Waits until every reader that entered before this call has left, so memory unlinked before this call can be deleted. */
+static void SchemaReclaimer_synchronize() {
+	uint64_t epoch = schemaReclaimer.epoch.fetch_add(1);
+	while (schemaReclaimer.readers[epoch & 1].load() > 0)
+		std::this_thread::yield();
+}
+
+
+/** Removes an item from a singly-linked list whose head may be prepended concurrently.
+Only one thread may unlink from the list at a time.
+*/
+template <typename T>
+static void List_unlink(std::atomic<T*>& head, T* item, std::atomic<T*> T::*next) {
+	T* h = item;
+	if (head.compare_exchange_strong(h, (item->*next).load(std::memory_order_relaxed)))
+		return;
+	// The item is no longer the head, and prepends only replace the head, so its predecessor's link is stable
+	for (T* p = head.load(std::memory_order_acquire); p; p = (p->*next).load(std::memory_order_acquire)) {
+		if ((p->*next).load(std::memory_order_relaxed) == item) {
+			(p->*next).store((item->*next).load(std::memory_order_relaxed));
+			return;
+		}
+	}
+}
+
+
+/** Lock-free set of every built Schema, keyed by content.
+Buckets grow by prepending, and only reclaim passes unlink schemas.
+*/
+struct SchemaSet {
+	static const uint32_t bucketCount = 1 << 10;
+	std::atomic<Schema*> buckets[bucketCount] = {};
+	std::atomic<uint64_t> count{0};
+};
+
+static SchemaSet schemaSet;
+
+
+static inline uint64_t Schema_hash_mix(uint64_t x) {
+	x ^= x >> 33;
+	x *= 0xFF51AFD7ED558CCDULL;
+	x ^= x >> 33;
+	return x;
+}
+
+
+/** Hashes the ordered class list and the unordered method and supermethod entries, so push orders that produce the same tables produce the same hash. */
+static uint64_t Schema_hash(const SchemaVector<SchemaSlotEntry>& slotIndices, const SchemaVector<SchemaMethodEntry>& methods, const SchemaVector<SchemaMethodEntry>& supermethods) {
+	uint64_t hash = slotIndices.size();
+	for (const SchemaSlotEntry& entry : slotIndices)
+		hash = Schema_hash_mix(hash ^ uint64_t(entry.key));
+	uint64_t methodsHash = 0;
+	for (const SchemaMethodEntry& entry : methods)
+		methodsHash += Schema_hash_mix(uint64_t(entry.key) * 0x9E3779B97F4A7C15ULL ^ uint64_t(entry.value));
+	uint64_t supermethodsHash = 0;
+	for (const SchemaMethodEntry& entry : supermethods)
+		supermethodsHash += Schema_hash_mix(uint64_t(entry.key) * 0x9E3779B97F4A7C15ULL ^ uint64_t(entry.value));
+	return Schema_hash_mix(hash ^ Schema_hash_mix(methodsHash) ^ Schema_hash_mix(supermethodsHash + 1));
+}
+
+
+static bool Schema_equal_is(const Schema* schema, uint64_t hash, const SchemaVector<SchemaSlotEntry>& slotIndices, const SchemaVector<SchemaMethodEntry>& methods, const SchemaVector<SchemaMethodEntry>& supermethods) {
+	if (schema->hash != hash)
+		return false;
+	if (schema->slotIndices.size != slotIndices.size() || schema->methods.size != methods.size() || schema->supermethods.size != supermethods.size())
+		return false;
+	for (const SchemaSlotEntry& entry : slotIndices) {
+		if (schema->classes[entry.value] != entry.key)
+			return false;
+	}
+	// Keys are distinct and sizes are equal, so finding every entry proves the maps are equal
+	for (const SchemaMethodEntry& entry : methods) {
+		void* const* method = schema->methods.find(entry.key);
+		if (!method || *method != entry.value)
+			return false;
+	}
+	for (const SchemaMethodEntry& entry : supermethods) {
+		void* const* supermethod = schema->supermethods.find(entry.key);
+		if (!supermethod || *supermethod != entry.value)
+			return false;
+	}
+	return true;
+}
+
+
+/** Adds a node reference to a schema, unless a reclaim pass has already claimed it. */
+static bool Schema_acquire(const Schema* schema) {
+	std::atomic<uint32_t>& nodes = const_cast<Schema*>(schema)->nodes;
+	uint32_t n = nodes.load(std::memory_order_relaxed);
+	while (n != Schema::dead) {
+		if (nodes.compare_exchange_weak(n, n + 1, std::memory_order_acquire, std::memory_order_relaxed))
+			return true;
+	}
+	return false;
+}
+
+
+static void Schema_release(const Schema* schema) {
+	const_cast<Schema*>(schema)->nodes.fetch_sub(1, std::memory_order_release);
+}
+
+
+/** Returns the interned schema with the given content with a new node reference, or NULL if none has been built.
+Must be called within a SchemaReadGuard.
+*/
+static const Schema* SchemaSet_find(uint64_t hash, const SchemaVector<SchemaSlotEntry>& slotIndices, const SchemaVector<SchemaMethodEntry>& methods, const SchemaVector<SchemaMethodEntry>& supermethods) {
+	std::atomic<Schema*>& bucket = schemaSet.buckets[hash & (SchemaSet::bucketCount - 1)];
+	for (const Schema* s = bucket.load(std::memory_order_acquire); s; s = s->next.load(std::memory_order_acquire)) {
+		if (Schema_equal_is(s, hash, slotIndices, methods, supermethods) && Schema_acquire(s))
+			return s;
+	}
+	return NULL;
+}
+
+
+/** Builds and interns a schema with the given content, and returns it with a new node reference.
+If another thread interns an equal schema first, returns that schema instead.
+Must be called within a SchemaReadGuard.
+*/
+static const Schema* SchemaSet_insert(uint64_t hash, const SchemaVector<SchemaSlotEntry>& slotIndices, const SchemaVector<SchemaMethodEntry>& methods, const SchemaVector<SchemaMethodEntry>& supermethods) {
+	Schema* schema = Schema_create(slotIndices, methods, supermethods);
+	schema->hash = hash;
+	schema->nodes.store(1, std::memory_order_relaxed);
+
+	std::atomic<Schema*>& bucket = schemaSet.buckets[hash & (SchemaSet::bucketCount - 1)];
+	Schema* head = bucket.load(std::memory_order_acquire);
+	schema->next.store(head, std::memory_order_relaxed);
+	// Race to replace the bucket's head until success
+	while (!bucket.compare_exchange_weak(head, schema, std::memory_order_acq_rel, std::memory_order_acquire)) {
+		// Another thread prepended schemas, so recheck only that new prefix.
+		// The previous head may have been unlinked by a reclaim pass, in which case the whole bucket is rechecked.
+		for (const Schema* s = head; s && s != schema->next.load(std::memory_order_relaxed); s = s->next.load(std::memory_order_acquire)) {
+			if (Schema_equal_is(s, hash, slotIndices, methods, supermethods) && Schema_acquire(s)) {
+				Schema_destroy(schema);
+				return s;
+			}
+		}
+		schema->next.store(head, std::memory_order_relaxed);
+	}
+	schemaSet.count.fetch_add(1, std::memory_order_relaxed);
+	return schema;
+}
+
+
+/** A node in the tree of class and method push histories.
+Nodes that push a class, and the parents of those nodes, always have a built schema, so removing classes never builds one.
+*/
 struct alignas(64) SchemaNode {
 	std::atomic<const Schema*> schema{NULL};
 	const SchemaNode* parent = NULL;
 	SchemaDelta delta = {};
 	// Next sibling in the parent's children list
-	SchemaNode* sibling = NULL;
+	std::atomic<SchemaNode*> sibling{NULL};
 	std::atomic<SchemaNode*> children{NULL};
+	/** Number of objects on this node, with the `dead` bit set once a reclaim pass claims it.
+	Failed acquires may briefly add to a dead node's count before undoing it.
+	The root node is never counted or reclaimed.
+	*/
+	std::atomic<uint32_t> objects{0};
+	/** Consecutive reclaim passes that found this node unused. Only accessed by reclaim passes. */
+	uint16_t idlePasses = 0;
+	/** Set by the first thread to claim building the node's schema, so concurrent first lookups don't build duplicates. */
+	std::atomic<bool> building{false};
+
+	static const uint32_t dead = uint32_t(1) << 31;
+};
+
+static_assert(sizeof(SchemaNode) == 64, "SchemaNode should fill one cache line");
+
+
+/** Adds an object to a node, unless a reclaim pass has already claimed the node.
+An object's node and its ancestors can't be claimed, so acquiring them always succeeds.
+*/
+static bool SchemaNode_acquire(const SchemaNode* node) {
+	if (!node->parent)
+		return true;
+	std::atomic<uint32_t>& objects = const_cast<SchemaNode*>(node)->objects;
+	// Increment unconditionally, so objects moving onto a popular node never retry.
+	// The dead bit is only set while the count is zero, so if it's clear, the node stays alive until this object leaves.
+	uint32_t n = objects.fetch_add(1, std::memory_order_acquire);
+	if (!(n & SchemaNode::dead))
+		return true;
+	objects.fetch_sub(1, std::memory_order_relaxed);
+	return false;
+}
+
+
+static void SchemaNode_release(const SchemaNode* node) {
+	if (!node->parent)
+		return;
+	const_cast<SchemaNode*>(node)->objects.fetch_sub(1, std::memory_order_release);
+}
+
+
+/** Lock-free bump allocator that packs SchemaNodes into chunks, so ancestor walks stay within a few pages instead of scattering across the heap.
+Chunks are never freed. Reclaimed nodes are recycled through a free list.
+*/
+struct SchemaNodeArena {
+	struct Chunk {
+		static const uint32_t capacity = 256;
+		alignas(SchemaNode) unsigned char storage[capacity * sizeof(SchemaNode)];
+		std::atomic<uint32_t> used{0};
+	};
+	std::atomic<Chunk*> chunk{NULL};
+	/** Reclaimed nodes linked by their sibling field.
+	Only reclaim passes push, and only after readers of the nodes have left, so a pop within a SchemaReadGuard can't see its head node recycled (ABA).
+	*/
+	std::atomic<SchemaNode*> freeList{NULL};
 };
 
+static SchemaNodeArena schemaNodeArena;
+/** A node this thread allocated but lost a creation race with, kept for its next allocation. */
+static thread_local SchemaNode* schemaNodeSpare = NULL;
+
+
+static SchemaNode* SchemaNode_alloc() {
+	if (schemaNodeSpare) {
+		SchemaNode* node = schemaNodeSpare;
+		schemaNodeSpare = NULL;
+		return new (node) SchemaNode;
+	}
+
+	// Pop a reclaimed node
+	{
+		SchemaReadGuard guard;
+		SchemaNode* head = schemaNodeArena.freeList.load(std::memory_order_acquire);
+		while (head && !schemaNodeArena.freeList.compare_exchange_weak(head, head->sibling.load(std::memory_order_relaxed), std::memory_order_acquire, std::memory_order_acquire)) {}
+		if (head)
+			return new (head) SchemaNode;
+	}
+
+	// Bump-allocate from the current chunk, or race to replace a full chunk
+	SchemaNodeArena::Chunk* chunk = schemaNodeArena.chunk.load(std::memory_order_acquire);
+	while (true) {
+		if (chunk) {
+			uint32_t index = chunk->used.fetch_add(1, std::memory_order_relaxed);
+			if (index < SchemaNodeArena::Chunk::capacity)
+				return new (&chunk->storage[index * sizeof(SchemaNode)]) SchemaNode;
+		}
+		SchemaNodeArena::Chunk* newChunk = ObjectAllocator_new<SchemaNodeArena::Chunk>(OBJECT_ALLOC_SCHEMAS);
+		newChunk->used.store(1, std::memory_order_relaxed);
+		if (schemaNodeArena.chunk.compare_exchange_strong(chunk, newChunk, std::memory_order_acq_rel, std::memory_order_acquire))
+			return new (newChunk->storage) SchemaNode;
+		// Another thread replaced the chunk first
+		ObjectAllocator_delete(OBJECT_ALLOC_SCHEMAS, newChunk);
+	}
+}
+
+
+/** Returns a reclaimed node to the arena.
+Must only be called by a reclaim pass after readers of the node have left.
+*/
+static void SchemaNode_free(SchemaNode* node) {
+	SchemaNode* head = schemaNodeArena.freeList.load(std::memory_order_relaxed);
+	do {
+		node->sibling.store(head, std::memory_order_relaxed);
+	} while (!schemaNodeArena.freeList.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+}
+
 
 /** Builds the schema of a node by applying each ancestor delta from the root down to the node, and caches it in the node.
+The caller must keep the node acquired.
 Thread-safe. If another thread builds the schema first, returns that schema.
 This function is called infrequently, so we don't want to inline it in hot Object functions.
 */
@@ -89,15 +457,18 @@ static const Schema* SchemaNode_schema_build(const SchemaNode* node) {
 	if (schema)
 		return schema;
 
-	// Collect ancestors
-	std::vector<const SchemaNode*> ancestors;
+	// Collect ancestors and accumulate each map's entries in the thread's scratch vectors, whose capacity is kept between builds
+	static thread_local SchemaVector<const SchemaNode*> ancestors;
+	static thread_local SchemaVector<SchemaMethodEntry> methods;
+	static thread_local SchemaVector<SchemaMethodEntry> supermethods;
+	static thread_local SchemaVector<SchemaSlotEntry> slotIndices;
+	ancestors.clear();
+	methods.clear();
+	supermethods.clear();
+	slotIndices.clear();
 	for (const SchemaNode* n = node; n; n = n->parent)
 		ancestors.push_back(n);
 
-	// Accumulate each map's entries
-	std::vector<PerfectHashMap<void*, void*>::Entry> methods;
-	std::vector<PerfectHashMap<void*, void*>::Entry> supermethods;
-	std::vector<PerfectHashMap<const Class*, uint32_t>::Entry> slotIndices;
 	uint32_t classCount = 0;
 	for (size_t i = ancestors.size(); i > 0; i--) {
 		const SchemaDelta& delta = ancestors[i - 1]->delta;
@@ -107,8 +478,8 @@ static const Schema* SchemaNode_schema_build(const SchemaNode* node) {
 		}
 		else if (delta.type == SchemaDelta::METHOD) {
 			// Find the method entry that this delta overrides
-			PerfectHashMap<void*, void*>::Entry* overriddenEntry = NULL;
-			for (PerfectHashMap<void*, void*>::Entry& entry : methods) {
+			SchemaMethodEntry* overriddenEntry = NULL;
+			for (SchemaMethodEntry& entry : methods) {
 				if (entry.key == delta.dispatcher) {
 					overriddenEntry = &entry;
 					break;
@@ -125,23 +496,37 @@ static const Schema* SchemaNode_schema_build(const SchemaNode* node) {
 		}
 	}
 
-	Schema* newSchema = new Schema;
-	newSchema->methods.build(methods.data(), methods.size());
-	newSchema->supermethods.build(supermethods.data(), supermethods.size());
-	newSchema->slotIndices.build(slotIndices.data(), slotIndices.size());
-	schema = newSchema;
+	// Share an equal schema built from another push order
+	uint64_t hash = Schema_hash(slotIndices, methods, supermethods);
+	{
+		SchemaReadGuard guard;
+		schema = SchemaSet_find(hash, slotIndices, methods, supermethods);
+		if (!schema)
+			schema = SchemaSet_insert(hash, slotIndices, methods, supermethods);
+	}
 
 	const Schema* existingSchema = NULL;
 	const_cast<SchemaNode*>(node)->schema.compare_exchange_strong(existingSchema, schema, std::memory_order_acq_rel, std::memory_order_acquire);
-	// Another thread built the same schema first
+	// Another thread published the node's schema first, which is the same interned schema
 	if (existingSchema) {
-		delete schema;
+		Schema_release(schema);
 		schema = existingSchema;
 	}
 	return schema;
 }
 
 
+/** Returns whether the calling thread is the first to claim building the node's schema.
+Threads that lose the claim answer lookups from the delta chain until the schema is published.
+*/
+static inline bool SchemaNode_build_claim(const SchemaNode* node) {
+	std::atomic<bool>& building = const_cast<SchemaNode*>(node)->building;
+	if (building.load(std::memory_order_relaxed))
+		return false;
+	return !building.exchange(true, std::memory_order_acquire);
+}
+
+
 static inline const Schema* SchemaNode_schema_get(const SchemaNode* node) {
 	const Schema* schema = node->schema.load(std::memory_order_acquire);
 	if (schema)
@@ -150,59 +535,83 @@ static inline const Schema* SchemaNode_schema_get(const SchemaNode* node) {
 }
 
 
+/** Returns the acquired child with the given delta, or NULL if not found. */
 static SchemaNode* SchemaNode_child_find(const SchemaNode* node, const SchemaDelta& delta) {
-	for (SchemaNode* c = node->children.load(std::memory_order_acquire); c; c = c->sibling) {
-		if (SchemaDelta_equal_is(c->delta, delta))
+	SchemaReadGuard guard;
+	for (SchemaNode* c = node->children.load(std::memory_order_acquire); c; c = c->sibling.load(std::memory_order_acquire)) {
+		if (SchemaDelta_equal_is(c->delta, delta) && SchemaNode_acquire(c))
 			return c;
 	}
 	return NULL;
 }
 
 
+/** Returns the acquired child with the given delta, creating it if not found. */
 static SchemaNode* SchemaNode_child_findOrCreate(const SchemaNode* node, const SchemaDelta& delta) {
+	SchemaReadGuard guard;
 	// Find child with matching delta, otherwise get first child
 	SchemaNode* head = node->children.load(std::memory_order_acquire);
-	for (SchemaNode* c = head; c; c = c->sibling) {
-		if (SchemaDelta_equal_is(c->delta, delta))
+	for (SchemaNode* c = head; c; c = c->sibling.load(std::memory_order_acquire)) {
+		if (SchemaDelta_equal_is(c->delta, delta) && SchemaNode_acquire(c))
 			return c;
 	}
 
 	// Create child
-	SchemaNode* child = new SchemaNode;
+	SchemaNode* child = SchemaNode_alloc();
 	child->parent = node;
 	child->delta = delta;
-	child->sibling = head;
+	child->sibling.store(head, std::memory_order_relaxed);
+	child->objects.store(1, std::memory_order_relaxed);
 
 	// Race to replace the node's head child until success
 	while (!const_cast<SchemaNode*>(node)->children.compare_exchange_weak(head, child, std::memory_order_acq_rel, std::memory_order_acquire)) {
-		// Another thread prepended children, so recheck only that new prefix
+		// Another thread prepended children, so recheck only that new prefix.
+		// The previous head may have been unlinked by a reclaim pass, in which case the whole list is rechecked.
 		SchemaNode* existingChild = NULL;
-		for (SchemaNode* c = head; c != child->sibling; c = c->sibling) {
-			if (SchemaDelta_equal_is(c->delta, delta)) {
+		for (SchemaNode* c = head; c && c != child->sibling.load(std::memory_order_relaxed); c = c->sibling.load(std::memory_order_acquire)) {
+			if (SchemaDelta_equal_is(c->delta, delta) && SchemaNode_acquire(c)) {
 				existingChild = c;
 				break;
 			}
 		}
 		// Another thread created the same child first
 		if (existingChild) {
-			delete child;
+			schemaNodeSpare = child;
 			child = existingChild;
 			break;
 		}
-		child->sibling = head;
+		child->sibling.store(head, std::memory_order_relaxed);
 	}
 	return child;
 }
 
 
+/** Must be called within a SchemaReadGuard. */
 static uint64_t SchemaNode_count_get(const SchemaNode* node) {
 	uint64_t count = 1;
-	for (const SchemaNode* c = node->children.load(std::memory_order_acquire); c; c = c->sibling)
+	for (const SchemaNode* c = node->children.load(std::memory_order_acquire); c; c = c->sibling.load(std::memory_order_acquire))
 		count += SchemaNode_count_get(c);
 	return count;
 }
 
 
+/** Builds the schemas of a node's existing descendants up to `depth` pushes deeper.
+Must be called within a SchemaReadGuard.
+*/
+static void SchemaNode_descendants_build(const SchemaNode* node, uint32_t depth) {
+	if (depth == 0)
+		return;
+	for (SchemaNode* c = node->children.load(std::memory_order_acquire); c; c = c->sibling.load(std::memory_order_acquire)) {
+		// Keep the node from being reclaimed while building its schema
+		if (!SchemaNode_acquire(c))
+			continue;
+		SchemaNode_schema_get(c);
+		SchemaNode_descendants_build(c, depth - 1);
+		SchemaNode_release(c);
+	}
+}
+
+
 static void* SchemaNode_method_find(const SchemaNode* node, void* dispatcher) {
 	// Walk up the ancestors to find the first method push delta for the dispatcher
 	for (const SchemaNode* n = node; n; n = n->parent) {
@@ -221,3 +630,327 @@ static void* SchemaNode_dispatcher_find(const SchemaNode* node, void* method) {
 	}
 	return NULL;
 }
+
+
+/** Returns the method that the given method overrode, by walking up to the delta that pushed the method and then to the previous push for its dispatcher. */
+static void* SchemaNode_supermethod_find(const SchemaNode* node, void* method) {
+	for (const SchemaNode* n = node; n; n = n->parent) {
+		if (n->delta.type == SchemaDelta::METHOD && n->delta.method == method)
+			return SchemaNode_method_find(n->parent, n->delta.dispatcher);
+	}
+	return NULL;
+}
+
+
+/** Finds the slot index of a class by counting the class push deltas at and above it, without the node's schema. */
+static bool SchemaNode_slotIndex_find(const SchemaNode* node, const Class* cls, uint32_t* slotIndex) {
+	// Slot indices count up from the root, so count classes pushed before cls
+	bool found = false;
+	uint32_t classesBefore = 0;
+	for (const SchemaNode* n = node; n; n = n->parent) {
+		if (n->delta.type != SchemaDelta::CLASS)
+			continue;
+		if (found)
+			classesBefore++;
+		else if (n->delta.cls == cls)
+			found = true;
+	}
+	if (found)
+		*slotIndex = classesBefore;
+	return found;
+}
+
+
+/** Returns the number of classes pushed along a node's chain. */
+static uint32_t SchemaNode_classes_count(const SchemaNode* node) {
+	uint32_t count = 0;
+	for (const SchemaNode* n = node; n; n = n->parent) {
+		if (n->delta.type == SchemaDelta::CLASS)
+			count++;
+	}
+	return count;
+}
+
+
+/** Returns the class with a slot index along a node's chain, or NULL if the chain has fewer classes. */
+static const Class* SchemaNode_class_get(const SchemaNode* node, uint64_t index) {
+	uint32_t count = SchemaNode_classes_count(node);
+	if (index >= count)
+		return NULL;
+	// Slot indices count up from the root, so skip the classes pushed after it
+	uint64_t classesAfter = count - 1 - index;
+	for (const SchemaNode* n = node; n; n = n->parent) {
+		if (n->delta.type != SchemaDelta::CLASS)
+			continue;
+		if (classesAfter == 0)
+			return n->delta.cls;
+		classesAfter--;
+	}
+	return NULL;
+}
+
+
+/** Background thread that builds schemas claimed by lookups in async mode. */
+struct SchemaBuilder {
+	/** Acquired nodes whose schemas are claimed but not built. */
+	BoundedQueue<const SchemaNode*, 1024> queue;
+	std::atomic<bool> enabled{false};
+	std::atomic<bool> stopping{false};
+	/** Serializes starting and stopping the thread. */
+	std::mutex mutex;
+	std::thread* thread = NULL;
+};
+
+static SchemaBuilder schemaBuilder;
+
+
+static void SchemaBuilder_drain() {
+	const SchemaNode* node;
+	while (schemaBuilder.queue.pop(node)) {
+		SchemaNode_schema_build(node);
+		SchemaNode_release(node);
+	}
+}
+
+
+static void SchemaBuilder_run() {
+	while (!schemaBuilder.stopping.load(std::memory_order_acquire)) {
+		SchemaBuilder_drain();
+		// Poll rather than wait on a condition variable, so enqueuing never makes a system call
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	SchemaBuilder_drain();
+}
+
+
+/** Hands a claimed node to the builder thread.
+Returns false if async mode is disabled or the queue is full, in which case the caller must build the schema itself.
+Never allocates or blocks.
+*/
+static bool SchemaBuilder_enqueue(const SchemaNode* node) {
+	if (!schemaBuilder.enabled.load(std::memory_order_relaxed))
+		return false;
+	SchemaNode_acquire(node);
+	if (!schemaBuilder.queue.push(node)) {
+		SchemaNode_release(node);
+		return false;
+	}
+	// Async mode may have been disabled after the check, so build the node here rather than strand its claim
+	if (!schemaBuilder.enabled.load(std::memory_order_seq_cst))
+		SchemaBuilder_drain();
+	return true;
+}
+
+
+static void SchemaBuilder_enabled_set(bool enabled) {
+	std::lock_guard<std::mutex> lock(schemaBuilder.mutex);
+	if (enabled == schemaBuilder.enabled.load(std::memory_order_relaxed))
+		return;
+	if (enabled) {
+		schemaBuilder.stopping.store(false, std::memory_order_relaxed);
+		schemaBuilder.thread = new std::thread(SchemaBuilder_run);
+		schemaBuilder.enabled.store(true, std::memory_order_seq_cst);
+	}
+	else {
+		schemaBuilder.enabled.store(false, std::memory_order_seq_cst);
+		schemaBuilder.stopping.store(true, std::memory_order_release);
+		schemaBuilder.thread->join();
+		delete schemaBuilder.thread;
+		schemaBuilder.thread = NULL;
+		SchemaBuilder_drain();
+	}
+}
+
+
+#if !defined _WIN32
+/** Returns the exported symbol name of a function, or NULL if the address isn't the start of an exported symbol. */
+static const char* Symbol_name_get(void* address) {
+	Dl_info info;
+	if (!dladdr(address, &info) || !info.dli_sname || info.dli_saddr != address)
+		return NULL;
+	return info.dli_sname;
+}
+#endif
+
+
+/** Returns the address of an exported symbol, or NULL if it isn't loaded or manifests aren't supported. */
+static void* Symbol_address_get(const std::string& name) {
+#if defined _WIN32
+	(void) name;
+	return NULL;
+#else
+	return dlsym(RTLD_DEFAULT, name.c_str());
+#endif
+}
+
+
+/** Appends a delta to a manifest line, as `C:<class name>` or `M:<dispatcher symbol>:<method symbol>`.
+Returns false if the delta has no stable identifier.
+*/
+static bool SchemaDelta_manifest_write(const SchemaDelta& delta, std::string& line) {
+#if defined _WIN32
+	// Classes couldn't be resolved on replay
+	(void) delta;
+	(void) line;
+#else
+	if (delta.type == SchemaDelta::CLASS) {
+		if (!delta.cls->name)
+			return false;
+		line += " C:";
+		line += delta.cls->name;
+		return true;
+	}
+	else if (delta.type == SchemaDelta::METHOD) {
+		const char* dispatcherName = Symbol_name_get(delta.dispatcher);
+		const char* methodName = Symbol_name_get(delta.method);
+		if (!dispatcherName || !methodName)
+			return false;
+		line += " M:";
+		line += dispatcherName;
+		line += ":";
+		line += methodName;
+		return true;
+	}
+#endif
+	return false;
+}
+
+
+/** Parses a delta written by SchemaDelta_manifest_write(), resolving classes as the `<name>_class` symbol defined by DEFINE_CLASS().
+Returns false if the token is malformed or its symbols aren't loaded.
+*/
+static bool SchemaDelta_manifest_read(const std::string& token, SchemaDelta& delta) {
+	if (token.compare(0, 2, "C:") == 0) {
+		std::string name = token.substr(2);
+		const Class* cls = (const Class*) Symbol_address_get(name + "_class");
+		if (!cls || !cls->name || name != cls->name)
+			return false;
+		delta = SchemaDelta_classPush(cls);
+		return true;
+	}
+	else if (token.compare(0, 2, "M:") == 0) {
+		size_t colon = token.find(':', 2);
+		if (colon == std::string::npos)
+			return false;
+		void* dispatcher = Symbol_address_get(token.substr(2, colon - 2));
+		void* method = Symbol_address_get(token.substr(colon + 1));
+		if (!dispatcher || !method)
+			return false;
+		delta = SchemaDelta_methodPush(dispatcher, method);
+		return true;
+	}
+	return false;
+}
+
+
+/** Appends a manifest line for each built node none of whose descendants are built, since replaying a path builds every node along it.
+`path` holds the line prefix for the node's ancestors, or is NULL if one of them has no stable identifier.
+Returns whether a line was written for the node or its descendants.
+Must be called within a SchemaReadGuard.
+*/
+static bool SchemaNode_manifest_export(const SchemaNode* node, const std::string* path, std::string& manifest) {
+	std::string line;
+	const std::string* childPath = NULL;
+	if (path) {
+		line = *path;
+		if (!node->parent || SchemaDelta_manifest_write(node->delta, line))
+			childPath = &line;
+	}
+	bool written = false;
+	for (const SchemaNode* c = node->children.load(std::memory_order_acquire); c; c = c->sibling.load(std::memory_order_acquire)) {
+		if (SchemaNode_manifest_export(c, childPath, manifest))
+			written = true;
+	}
+	if (written || !node->parent || !node->schema.load(std::memory_order_acquire))
+		return written;
+	// Paths through symbols without stable identifiers can't be replayed
+	if (!childPath)
+		return false;
+	manifest += line.substr(1);
+	manifest += "\n";
+	return true;
+}
+
+
+/** Unlinks the unused descendants of a node in post-order, so a chain of unused nodes is reclaimed in one pass.
+A node is unused if it has no objects and no children.
+Must hold the reclaimer mutex.
+*/
+static void SchemaNode_descendants_unlink(SchemaNode* node, uint32_t retention, SchemaVector<SchemaNode*>& unlinked) {
+	SchemaNode* c = node->children.load(std::memory_order_acquire);
+	while (c) {
+		// Load the sibling first, since unlinking c doesn't change its own sibling link
+		SchemaNode* sibling = c->sibling.load(std::memory_order_acquire);
+		SchemaNode_descendants_unlink(c, retention, unlinked);
+		if (c->children.load(std::memory_order_acquire) || c->objects.load(std::memory_order_relaxed) != 0) {
+			c->idlePasses = 0;
+		}
+		else if (++c->idlePasses >= retention) {
+			// Claim the node, failing if an object moved onto it since the check
+			uint32_t objects = 0;
+			if (!c->objects.compare_exchange_strong(objects, SchemaNode::dead, std::memory_order_acquire)) {
+				c->idlePasses = 0;
+			}
+			// An object may have visited the node and created a child before the claim
+			else if (c->children.load(std::memory_order_acquire)) {
+				// Clear only the bit, keeping the increments of acquires that haven't undone them yet
+				c->objects.fetch_and(~SchemaNode::dead, std::memory_order_release);
+				c->idlePasses = 0;
+			}
+			else {
+				List_unlink(node->children, c, &SchemaNode::sibling);
+				unlinked.push_back(c);
+			}
+		}
+		c = sibling;
+	}
+}
+
+
+/** Reclaims unused SchemaNodes, then Schemas no longer used by any node.
+Returns the number of bytes reclaimed.
+Thread-safe, but blocks until concurrent readers of the tree leave their SchemaReadGuard.
+*/
+static uint64_t SchemaNode_reclaim(SchemaNode* root) {
+	std::lock_guard<std::mutex> lock(schemaReclaimer.mutex);
+	// Clamp to the range of SchemaNode::idlePasses
+	uint32_t retention = std::min<uint32_t>(schemaReclaimer.retention.load(std::memory_order_relaxed), UINT16_MAX);
+
+	SchemaVector<SchemaNode*> unlinkedNodes;
+	SchemaNode_descendants_unlink(root, retention, unlinkedNodes);
+	for (SchemaNode* node : unlinkedNodes) {
+		const Schema* schema = node->schema.load(std::memory_order_acquire);
+		if (schema)
+			Schema_release(schema);
+	}
+
+	// Claim and unlink schemas that no node uses
+	SchemaVector<Schema*> unlinkedSchemas;
+	for (std::atomic<Schema*>& bucket : schemaSet.buckets) {
+		Schema* s = bucket.load(std::memory_order_acquire);
+		while (s) {
+			Schema* next = s->next.load(std::memory_order_acquire);
+			uint32_t nodes = 0;
+			if (s->nodes.compare_exchange_strong(nodes, Schema::dead, std::memory_order_acquire)) {
+				List_unlink(bucket, s, &Schema::next);
+				unlinkedSchemas.push_back(s);
+			}
+			s = next;
+		}
+	}
+
+	SchemaReclaimer_synchronize();
+
+	uint64_t bytes = 0;
+	for (SchemaNode* node : unlinkedNodes) {
+		bytes += sizeof(SchemaNode);
+		SchemaNode_free(node);
+	}
+	for (Schema* schema : unlinkedSchemas) {
+		bytes += schema->bytes_get();
+		Schema_destroy(schema);
+	}
+	schemaSet.count.fetch_sub(unlinkedSchemas.size(), std::memory_order_relaxed);
+	schemaReclaimer.reclaimedBytes.fetch_add(bytes, std::memory_order_relaxed);
+	return bytes;
+}